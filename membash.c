@@ -29,38 +29,198 @@
 //
 ////////////////////////////////////////////////////////////////////////
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <limits.h>
 #include <time.h>
+#include <math.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 
-#include <sys/time.h>
 #include <sys/mman.h>
 
 #include "src/argconfig.h"
 #include "src/suffix.h"
 #include "src/report.h"
+#include "src/topology.h"
+#include "src/numa.h"
+#include "src/simd.h"
+#include "src/timer.h"
+#include "src/stats.h"
+#include "src/results.h"
+#include "src/perf.h"
+#include "src/freq.h"
+#include "src/pages.h"
+
+#define FEISTEL_ROUNDS 4
+
+/*
+ * A keyed permutation of [0, n) computed on the fly: a balanced
+ * Feistel network over the smallest even number of bits covering n,
+ * walked until it lands back inside [0, n).
+ */
+struct feistel {
+	size_t   n;
+	unsigned half;
+	uint64_t mask;
+	uint64_t keys[FEISTEL_ROUNDS];
+};
+
+enum {
+	PERMUTE_INDEX,
+	PERMUTE_FEISTEL,
+	PERMUTE_BOTH,
+};
+
+/*
+ * Where the memcpy run copies from and to: DRAM or the IOMEM behind
+ * --mmap / --mmap-dst.
+ */
+enum {
+	DIRECTION_D2D,
+	DIRECTION_D2I,
+	DIRECTION_I2D,
+	DIRECTION_I2I,
+	DIRECTION_COUNT,
+};
+
+#define DIRECTION_DST_IOMEM 1
+#define DIRECTION_SRC_IOMEM 2
+
+static const char *direction_names[DIRECTION_COUNT] = {
+	[DIRECTION_D2D] = "d2d",
+	[DIRECTION_D2I] = "d2i",
+	[DIRECTION_I2D] = "i2d",
+	[DIRECTION_I2I] = "i2i",
+};
+
+struct membash_thread;
 
 struct membash {
 	void          *mem;
 	size_t        size;
 	size_t        iters;
-	unsigned      seed;
-	unsigned      blockcpy;
+	size_t        seed;
+	size_t        blockcpy;
+	void                    (* blockcpy_fn)(struct membash_thread *);
 	unsigned      hash;
 	unsigned      fence;
 	unsigned      verbose;
+	char          *clock;
+	char          *format;
+	FILE          *out;
+	struct results results;
+	unsigned      threads;
+	unsigned      sweep;
+	unsigned      quiet;
+	unsigned      percentiles;
+	unsigned      sample;
+
+	size_t        warmup;
+	double        converge;
+	double        time_budget;
+	double        duration;
+	double        interval;
+	int           stop;
+	unsigned      running;
+	size_t        done;
+	double        ci;
+
+	char          *perf;
+	double        counts[PERF_MAX_EVENTS];
+
+	unsigned      cycles;
+	double        cycle_count;
+	uint64_t      busy_ns;
+
+	char          *save_baseline;
+	char          *compare;
+	double        tolerance;
+	struct results baseline;
+
+	char          *placement;
+	int           *cpus;
+	int           ncpus;
+	int           cpu_node;
+	int           mem_node;
+	unsigned      numa_matrix;
+
+	char          *simd;
+	int           simd_isa;
+	simd_sum_fn   simd_sum;
+	simd_write_fn writer;
+	char          *copy_engine;
+	int           copy_all;
+	simd_copy_fn  copy;
+	unsigned      dirty;
+
+	unsigned      latency;
+	unsigned      wss;
+	unsigned      mlp;
+
+	unsigned      stream;
+	char          *stream_dram;
+	double        *stream_a;
+	double        *stream_b;
+	double        *stream_c;
+	unsigned      chains;
+	size_t        chase_loads;
+	void          **chase_heads;
+	struct stats  *chase_stats;
 
 	char          *mmap;
 	int           mmapfd;
+	char          *mmap_dst;
+	int           mmap_dstfd;
+	void          *dst_map;
+	char          *direction;
+	int           direction_kind;
+
+	char          *pages;
+	int           pages_kind;
+	int                     (* pages_run)(struct membash *);
+
+	void          *src;
+	void          *dst;
+	char          *permute;
+	int           permute_kind;
+	size_t        *hash_idx;
+	struct feistel feistel;
+	double        rate;
+	size_t        iterations;
+	double        rate_cv;
+	unsigned      arrays;
 
 	int                     (* run)(struct membash *);
 
-	struct timeval          start_time;
-	struct timeval          end_time;
+	uint64_t                start_ns;
+	uint64_t                end_ns;
+	uint64_t                timed_ns;
+};
+
+struct membash_thread {
+	struct membash          *m;
+	unsigned                id;
+	pthread_t               thread;
+	pthread_barrier_t       *barrier;
+
+	void                    (* iter)(struct membash_thread *);
+
+	size_t                  offset;
+	size_t                  size;
+	unsigned                sum;
+	struct stats            *stats;
+	size_t                  done;
+	struct perf_group       perf;
+	double                  counts[PERF_MAX_EVENTS];
+	struct freq_sample      freq;
+	double                  cycles;
+
+	uint64_t                start_ns;
+	uint64_t                end_ns;
 };
 
 static const struct membash defaults = {
@@ -72,6 +232,19 @@ static const struct membash defaults = {
 	.mmap       = NULL,
 	.hash       = 0,
 	.verbose    = 0,
+	.clock      = "auto",
+	.format     = "text",
+	.threads    = 1,
+	.placement  = NULL,
+	.cpu_node   = -1,
+	.mem_node   = -1,
+	.simd       = "auto",
+	.chains     = 1,
+	.arrays     = 1,
+	.stream_dram = "",
+	.permute    = "index",
+	.tolerance  = 5.0,
+	.time_budget = 10.0,
 };
 
 const char program_desc[] =
@@ -91,10 +264,89 @@ static const struct argconfig_commandline_options command_line_options[] = {
 	 "random seed to use for data (set to 0 for auto-gen seed)"},
 	{"mmap",          "MMAP", CFG_STRING, &defaults.mmap, required_argument,
 	 "file to mmap"},
+	{"mmap-dst",      "MMAP", CFG_STRING, &defaults.mmap_dst, required_argument,
+	 "file to mmap as the memcpy destination"},
+	{"direction",     "DIR", CFG_STRING, &defaults.direction, required_argument,
+	 "memcpy from and to DRAM (d) or IOMEM (i): d2d, d2i, i2d or i2i. "
+	 "IOMEM sources are --mmap, IOMEM destinations are --mmap-dst, or "
+	 "--mmap when copying from DRAM"},
 	{"hash",          "", CFG_NONE, &defaults.hash, no_argument,
 	 "use a fisher-yates hash in blockcpy mode"},
+	{"permute",       "MODE", CFG_STRING, &defaults.permute, required_argument,
+	 "--hash order from a precomputed index array (index), a keyed "
+	 "feistel permutation computed on the fly (feistel) or both"},
+	{"t",             "NUM", CFG_POSITIVE, &defaults.threads, required_argument, NULL},
+	{"threads",       "NUM", CFG_POSITIVE, &defaults.threads, required_argument,
+	 "number of threads to split the buffer across"},
+	{"placement",     "POLICY", CFG_STRING, &defaults.placement, required_argument,
+	 "pin threads compact (fill each socket), scatter (across sockets) "
+	 "or smt (pair SMT siblings)"},
+	{"cpu-node",      "NODE", CFG_INT, &defaults.cpu_node, required_argument,
+	 "only run threads on the cpus of this NUMA node"},
+	{"mem-node",      "NODE", CFG_INT, &defaults.mem_node, required_argument,
+	 "bind the test buffers to this NUMA node"},
+	{"numa-matrix",   "", CFG_NONE, &defaults.numa_matrix, no_argument,
+	 "measure every cpu node against every memory node"},
+	{"simd",          "ISA", CFG_STRING, &defaults.simd, required_argument,
+	 "vector width for the simd read: auto, scalar, sse2, avx2 or avx512"},
+	{"copy-engine",   "ENGINE", CFG_STRING, &defaults.copy_engine, required_argument,
+	 "copy with glibc memcpy, movsb (rep movsb), loop64 (64 bit loads "
+	 "and stores), avx2, avx512, nt (widest non-temporal stores) or "
+	 "each in turn (all)"},
+	{"latency",       "", CFG_NONE, &defaults.latency, no_argument,
+	 "measure the load latency with a pointer chase over 4KiB up to --size"},
+	{"wss",           "", CFG_NONE, &defaults.wss, no_argument,
+	 "sweep the working set from 4KiB up to --size to map the caches"},
+	{"mlp",           "NUM", CFG_POSITIVE, &defaults.mlp, required_argument,
+	 "chase 1 up to NUM (max 32) independent pointer chains at once"},
+	{"stream",        "", CFG_NONE, &defaults.stream, no_argument,
+	 "run the STREAM copy, scale, add and triad kernels"},
+	{"stream-dram",   "ARRAYS", CFG_STRING, &defaults.stream_dram, required_argument,
+	 "put these STREAM arrays (any of a, b and c) in DRAM rather than "
+	 "the test buffer, eg. to split them across DRAM and --mmap"},
+	{"percentiles",   "", CFG_NONE, &defaults.percentiles, no_argument,
+	 "time every iteration and report rate percentiles and a histogram"},
+	{"sweep",         "", CFG_NONE, &defaults.sweep, no_argument,
+	 "run each kernel with 1 up to --threads threads and report the scaling"},
+	{"warmup",        "NUM", CFG_LONG_SUFFIX, &defaults.warmup, required_argument,
+	 "run NUM untimed iterations of each kernel before timing it"},
+	{"converge",      "PCT", CFG_DOUBLE, &defaults.converge, required_argument,
+	 "repeat each kernel (at least --iters times) until the 95% confidence "
+	 "interval of its rate is within +/-PCT"},
+	{"time-budget",   "SEC", CFG_DOUBLE, &defaults.time_budget, required_argument,
+	 "give up on --converge after SEC seconds per kernel (default 10)"},
+	{"time",          "SEC", CFG_DOUBLE, &defaults.duration, required_argument,
+	 "repeat each kernel for SEC seconds rather than --iters times"},
+	{"interval",      "SEC", CFG_DOUBLE, &defaults.interval, required_argument,
+	 "print the rate over every SEC seconds while a kernel runs"},
+	{"perf",          "EVENTS", CFG_STRING, &defaults.perf, required_argument,
+	 "count these perf events (default, or a list of cycles, instructions, "
+	 "cache-misses, l1d-misses, llc-loads, llc-misses, dtlb-loads, "
+	 "dtlb-misses, task-clock, page-faults or rNNNN raw codes) around "
+	 "each kernel"},
+	{"cycles",        "", CFG_NONE, &defaults.cycles, no_argument,
+	 "report the effective core frequency, bytes per cycle and cycles "
+	 "per line of each kernel"},
+	{"pages",         "SIZE", CFG_STRING, &defaults.pages, required_argument,
+	 "back the buffers with 4k pages, thp, or 2m or 1g hugetlb pages "
+	 "(--mmap files must be on a matching hugetlbfs), or run with each "
+	 "in turn (all)"},
+	{"save-baseline", "FILE", CFG_STRING, &defaults.save_baseline, required_argument,
+	 "save the configuration and results to FILE for a later --compare, "
+	 "which needs --iters of at least 8, --converge or --time to "
+	 "estimate the noise"},
+	{"compare",       "FILE", CFG_STRING, &defaults.compare, required_argument,
+	 "rerun the configuration saved in FILE and exit with 2 if any "
+	 "kernel regressed"},
+	{"tolerance",     "PCT", CFG_DOUBLE, &defaults.tolerance, required_argument,
+	 "smallest slowdown --compare counts as a regression, widened when "
+	 "either run was noisier (default 5%)"},
 	{"fence",         "", CFG_NONE, &defaults.fence, no_argument,
 	 "add a mfence between setup and run"},
+	{"clock",         "CLOCK", CFG_STRING, &defaults.clock, required_argument,
+	 "clock to time with: auto, monotonic or tsc"},
+	{"format",        "FMT", CFG_STRING, &defaults.format, required_argument,
+	 "output format: text, json or csv (text then goes to stderr)"},
 	{"v",             "", CFG_NONE, &defaults.verbose, no_argument, NULL},
 	{"verbose",       "", CFG_NONE, &defaults.verbose, no_argument,
 	 "be verbose"},
@@ -114,190 +366,2422 @@ static size_t fisher_yates(size_t *in, size_t len)
 	return len;
 }
 
-static int setup(struct membash *m)
+static uint64_t splitmix64(uint64_t *state)
 {
-	unsigned sum = 0, *ptr;
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
 
-	if ( m->mmap ){
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
 
-		m->mmapfd = open(m->mmap, O_RDWR);
-		if ( m->mmapfd<0 ){
-			fprintf(stderr,"%s\n",strerror(errno));
-			exit(errno);
-		}
-		m->mem = mmap(NULL, m->size, PROT_WRITE | PROT_READ,
-			      MAP_SHARED, m->mmapfd, 0);
-		if ( m->mem==MAP_FAILED ){
-			fprintf(stderr,"%s\n",strerror(errno));
-			exit(errno);
+static void feistel_init(struct feistel *f, size_t n, uint64_t seed)
+{
+	unsigned bits = 2;
+
+	while (bits < 64 && (1ULL << bits) < n)
+		bits += 2;
+
+	f->n    = n;
+	f->half = bits / 2;
+	f->mask = (1ULL << f->half) - 1;
+	for (int r=0; r<FEISTEL_ROUNDS; r++)
+		f->keys[r] = splitmix64(&seed);
+}
+
+/*
+ * The domain is at most 4n so on average this walks less than four
+ * times, with no table to load.
+ */
+static inline size_t feistel(const struct feistel *f, size_t i)
+{
+	uint64_t l, r, t;
+
+	do {
+		l = i >> f->half;
+		r = i & f->mask;
+		for (int k=0; k<FEISTEL_ROUNDS; k++) {
+			t = (r ^ f->keys[k]) * 0x9e3779b97f4a7c15ULL;
+			t = l ^ ((t ^ (t >> 29)) & f->mask);
+			l = r;
+			r = t;
 		}
+		i = (l << f->half) | r;
+	} while (i >= f->n);
+
+	return i;
+}
+
+/*
+ * Record the last timed run for --format json/csv.
+ */
+static struct result *add_result(struct membash *m, const char *kernel,
+				 size_t size, size_t bytes)
+{
+	struct result *r = results_add(&m->results, kernel);
+
+	r->size     = size;
+	r->threads  = m->threads;
+	r->bytes    = bytes;
+	r->ns       = m->end_ns > m->start_ns ? m->end_ns - m->start_ns : 0;
+	r->rate     = r->ns ? bytes * 1e9 / r->ns : 0;
+	r->cpu_node = m->cpu_node;
+	r->mem_node = m->mem_node;
+	for (int i=0; i<perf_events(); i++)
+		r->events[i] = m->counts[i];
+	if (m->pages_kind != PAGES_DEFAULT)
+		snprintf(r->pages, sizeof(r->pages), "%s",
+			 pages_name(m->pages_kind));
+	if (m->cycles && m->cycle_count > 0 && m->busy_ns) {
+		r->cycles = m->cycle_count;
+		r->ghz    = m->cycle_count / m->busy_ns;
+	}
+
+	/* The noise estimate only belongs to the run that just finished */
+	r->iterations = m->iterations;
+	r->rate_cv    = m->rate_cv;
+	m->iterations = 0;
+	m->rate_cv    = 0;
+
+	return r;
+}
+
+/*
+ * Print the cycles and perf counts of the last timed run against the
+ * bytes it moved. The cycles are summed over every thread so bytes
+ * per cycle is per core.
+ */
+static void print_counters(struct membash *m, size_t bytes)
+{
+	if (m->cycles) {
+		fprintf(m->out, "  %-14s: ", "cycles");
+		if (m->cycle_count > 0 && m->busy_ns)
+			fprintf(m->out, "%8.3f GHz  %10.4f bytes/cycle  "
+				"%10.3f cycles/line\n",
+				m->cycle_count / m->busy_ns,
+				bytes / m->cycle_count,
+				m->cycle_count * 64 / bytes);
+		else
+			fprintf(m->out, "not counted\n");
+	}
+
+	for (int i=0; i<perf_events(); i++) {
+		fprintf(m->out, "  %-14s: ", perf_event_name(i));
+		report_event_rate(m->out, m->counts[i], bytes);
+		fprintf(m->out, "\n");
+	}
+}
+
+/*
+ * Allocate a test buffer of m->pages_kind pages, bound to m->mem_node
+ * if one was given. The binding has to happen before the pages are
+ * first touched so these come straight from mmap rather than malloc.
+ */
+static void *alloc_buffer(struct membash *m, size_t size)
+{
+	void *buf;
+
+	if (m->pages_kind != PAGES_DEFAULT)
+		buf = pages_alloc(size, m->pages_kind);
+	else if (m->mem_node < 0)
+		return malloc(size);
+	else {
+		buf = mmap(NULL, size, PROT_WRITE | PROT_READ,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			buf = NULL;
+	}
+	if (buf == NULL || m->mem_node < 0)
+		return buf;
+
+	if (numa_bind(buf, size, m->mem_node)){
+		fprintf(stderr,"could not bind to node %d: %s\n",
+			m->mem_node, strerror(errno));
+		exit(errno);
 	}
+
+	return buf;
+}
+
+static void free_buffer(struct membash *m, void *buf, size_t size)
+{
+	if (m->pages_kind != PAGES_DEFAULT)
+		pages_free(buf, size, m->pages_kind);
+	else if (m->mem_node < 0)
+		free(buf);
 	else
-		m->mem = malloc(m->size);
+		munmap(buf, size);
+}
 
-	if (m->mem == NULL){
-		fprintf(stderr,"could not allocate for mem!\n");
-		exit(1);
+static double elapsed(uint64_t start_ns, uint64_t end_ns)
+{
+	return end_ns > start_ns ? (end_ns - start_ns) / 1e9 : 0;
+}
+
+/*
+ * Split the buffer into one slice per thread. Slices are a multiple
+ * of align bytes and the last thread picks up whatever is left over.
+ */
+static void slice(struct membash *m, struct membash_thread *t,
+		  size_t align)
+{
+	size_t units = m->size / align;
+	size_t per   = units / m->threads;
+	size_t extra = units % m->threads;
+
+	t->offset = (t->id*per + (t->id < extra ? t->id : extra)) * align;
+	t->size   = (per + (t->id < extra ? 1 : 0)) * align;
+	if (t->id == m->threads-1)
+		t->size = m->size - t->offset;
+}
+
+static void pin_thread(struct membash_thread *t)
+{
+	struct membash *m = t->m;
+	cpu_set_t cpuset;
+	int ret;
+
+	if (!m->cpus)
+		return;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(m->cpus[t->id % m->ncpus], &cpuset);
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset),
+				     &cpuset);
+	if (ret){
+		fprintf(stderr,"%s (%d)\n",strerror(ret),
+			ret);
+		exit(ret);
 	}
-	ptr = m->mem;
+}
 
-	gettimeofday(&m->start_time, NULL);
-	for (size_t i=0; i<(m->size/sizeof(unsigned))-1; i++) {
-		ptr[i] = (unsigned)rand();
-		sum += ptr[i];
+/*
+ * Start and stop the clock and any --perf and --cycles counters
+ * around a thread's timed region. The perf group has to be opened
+ * first, outside the region.
+ */
+static void counters_start(struct membash_thread *t)
+{
+	if (t->m->cycles)
+		freq_start(&t->freq);
+	perf_start(&t->perf);
+	t->start_ns = timer_start();
+}
+
+static void counters_stop(struct membash_thread *t)
+{
+	t->end_ns = timer_stop();
+	perf_stop(&t->perf, t->counts);
+	perf_close(&t->perf);
+	if (t->m->cycles)
+		t->cycles = freq_stop(&t->freq, t->end_ns - t->start_ns);
+}
+
+/*
+ * The aggregate is timed from the first thread to start to the last
+ * one to finish, and the counters are summed over all of them.
+ */
+static void merge_counters(struct membash *m, struct membash_thread *t)
+{
+	m->start_ns = t[0].start_ns;
+	m->end_ns   = t[0].end_ns;
+	for (unsigned i=1; i<m->threads; i++) {
+		if (t[i].start_ns < m->start_ns)
+			m->start_ns = t[i].start_ns;
+		if (t[i].end_ns > m->end_ns)
+			m->end_ns = t[i].end_ns;
 	}
-	ptr[m->size/sizeof(unsigned)-1] = UINT_MAX - sum + 1;
 
-	gettimeofday(&m->end_time, NULL);
-	fprintf(stdout, "Wrote           : ");
-	report_transfer_rate(stdout, &m->start_time,
-			     &m->end_time, m->size);
-	fprintf(stdout, "\n");
+	for (int e=0; e<perf_events(); e++) {
+		m->counts[e] = 0;
+		for (unsigned i=0; i<m->threads && m->counts[e] >= 0; i++)
+			m->counts[e] = t[i].counts[e] < 0 ? -1 :
+				m->counts[e] + t[i].counts[e];
+	}
 
-	return 0;
+	m->cycle_count = 0;
+	m->busy_ns = 0;
+	for (unsigned i=0; i<m->threads && m->cycle_count >= 0; i++) {
+		m->cycle_count = t[i].cycles < 0 ? -1 :
+			m->cycle_count + t[i].cycles;
+		m->busy_ns += t[i].end_ns - t[i].start_ns;
+	}
 }
 
-static int run_memcpy(struct membash *m)
+#define FILL_CHUNK (1 << 20)
+
+struct xoshiro {
+	uint64_t s[4];
+};
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t xoshiro256ss(struct xoshiro *x)
+{
+	uint64_t result = rotl(x->s[1] * 5, 7) * 9;
+	uint64_t t = x->s[1] << 17;
+
+	x->s[2] ^= x->s[0];
+	x->s[3] ^= x->s[1];
+	x->s[1] ^= x->s[2];
+	x->s[0] ^= x->s[3];
+	x->s[2] ^= t;
+	x->s[3] = rotl(x->s[3], 45);
+
+	return result;
+}
+
+/*
+ * Every FILL_CHUNK of the buffer comes from its own xoshiro256** stream
+ * seeded by --seed and the chunk's place in the buffer, so the contents
+ * only depend on the seed and not on how many threads filled it. The
+ * threads take the same 64 byte aligned slices as the kernels, so each
+ * one first touches the pages it later runs over; a slice starting
+ * part way into a chunk skips ahead in that chunk's stream.
+ */
+static void *fill_main(void *arg)
+{
+	struct membash_thread *t = arg;
+	struct membash *m = t->m;
+	char *mem = m->mem;
+	unsigned sum = 0;
+
+	pin_thread(t);
+	if (perf_events())
+		perf_open(&t->perf);
+	counters_start(t);
+
+	for (size_t off=t->offset; off<t->offset+t->size;
+	     off=(off / FILL_CHUNK + 1) * FILL_CHUNK) {
+		uint64_t seed = rotl(m->seed, 32) ^ (off / FILL_CHUNK);
+		size_t skip = off % FILL_CHUNK;
+		size_t len = t->offset + t->size - off;
+		struct xoshiro x;
+		uint64_t *ptr = (uint64_t *)(mem + off), v;
+		size_t words;
+
+		for (int i=0; i<4; i++)
+			x.s[i] = splitmix64(&seed);
+		for (size_t i=0; i<skip / sizeof(uint64_t); i++)
+			xoshiro256ss(&x);
+
+		if (len > FILL_CHUNK - skip)
+			len = FILL_CHUNK - skip;
+		words = len / sizeof(uint64_t);
+		for (size_t i=0; i<words; i++) {
+			v = xoshiro256ss(&x);
+			ptr[i] = v;
+			sum += (unsigned)v + (unsigned)(v >> 32);
+		}
+		if (len % sizeof(uint64_t) >= sizeof(unsigned)) {
+			unsigned *tail = (unsigned *)(ptr + words);
+
+			*tail = (unsigned)xoshiro256ss(&x);
+			sum += *tail;
+		}
+	}
+
+	counters_stop(t);
+	t->sum = sum;
+	return NULL;
+}
+
+/*
+ * Fill the buffer with random data that sums to zero, in parallel
+ * across --threads: the last word is then patched to cancel out the
+ * sum of everything else.
+ */
+static void fill(struct membash *m)
 {
-	void *dst;
+	unsigned sum = 0, *last;
+	struct membash_thread *t;
+	int ret;
 
-	dst = malloc(m->size);
-	if ( dst == NULL ){
+	t = calloc(m->threads, sizeof(*t));
+	if (t == NULL){
 		fprintf(stderr,"%s (%d)\n",strerror(errno),
 			errno);
 		exit(errno);
 	}
 
-	gettimeofday(&m->start_time, NULL);
-	for (size_t iters=0; iters < m->iters; iters++)
-	{
-		memcpy(dst, m->mem, m->size);
+	for (unsigned i=0; i<m->threads; i++) {
+		t[i].m  = m;
+		t[i].id = i;
+		slice(m, &t[i], 64);
+
+		ret = pthread_create(&t[i].thread, NULL, fill_main, &t[i]);
+		if (ret){
+			fprintf(stderr,"%s (%d)\n",strerror(ret),
+				ret);
+			exit(ret);
+		}
+	}
+
+	for (unsigned i=0; i<m->threads; i++) {
+		pthread_join(t[i].thread, NULL);
+		sum += t[i].sum;
 	}
-	gettimeofday(&m->end_time, NULL);
-	fprintf(stdout, "Read (memcpy)   : ");
-	report_transfer_rate(stdout, &m->start_time,
-			     &m->end_time,
-			     m->iters*m->size);
-	fprintf(stdout, "\n");
 
-	free(dst);
-	return 0;
+	merge_counters(m, t);
+	free(t);
+
+	last = (unsigned *)m->mem + m->size/sizeof(unsigned) - 1;
+	*last = -(sum - *last);
+
+	if (m->quiet)
+		return;
+
+	add_result(m, "Wrote", m->size, m->size);
+	fprintf(m->out, "Wrote           : ");
+	report_transfer_rate(m->out, m->start_ns,
+			     m->end_ns, m->size);
+	fprintf(m->out, "\n");
+	print_counters(m, m->size);
 }
 
-static int run_dumb(struct membash *m)
+/*
+ * Report the pages the kernel actually backed the (touched) buffer
+ * with, which for thp can be anything from none to all huge pages.
+ */
+static void print_pages(struct membash *m)
 {
-	unsigned sum = 0, *ptr;
+	size_t page_size, huge;
+	long long size_ll;
+	const char *suffix;
 
-	ptr = m->mem;
-
-	gettimeofday(&m->start_time, NULL);
-	for (size_t iters=0; iters < m->iters; iters++)
-	{
-		sum = 0;
-		for (size_t i=0; i<(m->size/sizeof(unsigned)); i++)
-			sum += ptr[i];
-		if ( sum ){
-			fprintf(stderr,"sum did not add to zero (%u)!\n",
-				sum);
-			exit(1);
-		}
+	if (!m->pages || m->quiet ||
+	    pages_query(m->mem, m->size, &page_size, &huge))
+		return;
+
+	size_ll = page_size;
+	suffix = suffix_binary_get(&size_ll);
+	fprintf(m->out, "Pages           : %s, %lld%sB pages",
+		pages_name(m->pages_kind), size_ll, suffix);
+	if (huge || m->pages_kind == PAGES_THP)
+		fprintf(m->out, ", %.1f%% in transparent huge pages",
+			100.0 * huge / m->size);
+	fprintf(m->out, "\n");
+}
+
+/*
+ * Kernels that overwrite the buffer set m->dirty; anything relying on
+ * the zero-sum pattern refills it first.
+ */
+static void refill(struct membash *m)
+{
+	unsigned quiet = m->quiet;
+
+	if (!m->dirty)
+		return;
+
+	m->quiet = 1;
+	fill(m);
+	m->quiet = quiet;
+	m->dirty = 0;
+}
+
+static void *map_file(struct membash *m, const char *path, int *fd)
+{
+	void *buf;
+
+	*fd = open(path, O_RDWR);
+	if ( *fd<0 ){
+		fprintf(stderr,"%s\n",strerror(errno));
+		exit(errno);
+	}
+	buf = mmap(NULL, m->size, PROT_WRITE | PROT_READ,
+		   MAP_SHARED, *fd, 0);
+	if ( buf==MAP_FAILED ){
+		fprintf(stderr,"%s\n",strerror(errno));
+		exit(errno);
+	}
+	if (pages_map_file(buf, m->size, *fd, m->pages_kind)){
+		fprintf(stderr,"%s does not give %s pages: %s\n",
+			path, pages_name(m->pages_kind),
+			strerror(errno));
+		exit(errno);
+	}
+
+	return buf;
+}
+
+static int setup(struct membash *m)
+{
+	if ( m->mmap )
+		m->mem = map_file(m, m->mmap, &m->mmapfd);
+	else
+		m->mem = alloc_buffer(m, m->size);
+
+	if ( m->mmap_dst )
+		m->dst_map = map_file(m, m->mmap_dst, &m->mmap_dstfd);
+
+	if (m->mem == NULL && m->pages_kind != PAGES_DEFAULT){
+		fprintf(stderr,"could not allocate %s pages: %s\n",
+			pages_name(m->pages_kind), strerror(errno));
+		exit(errno);
+	}
+	if (m->mem == NULL){
+		fprintf(stderr,"could not allocate for mem!\n");
+		exit(1);
 	}
-	gettimeofday(&m->end_time, NULL);
-	fprintf(stdout, "Read (dumb)     : ");
-	report_transfer_rate(stdout, &m->start_time,
-			     &m->end_time,
-			     m->iters*m->size);
-	fprintf(stdout, "\n");
+
+	fill(m);
+	print_pages(m);
 
 	return 0;
 }
 
-static int run_blockcpy(struct membash *m)
+#define CONVERGE_MIN_ITERS 8
+#define CONVERGE_Z         1.96
+
+/*
+ * Half width of the 95% confidence interval of the mean iteration
+ * time, relative to that mean.
+ */
+static double ci(const struct stats *s)
 {
-	typedef struct { char a[m->blockcpy]; } membash_t;
-	membash_t dst, *ptr;
-	size_t *hash = NULL;
+	if (s->count < 2 || s->mean <= 0)
+		return INFINITY;
 
-	ptr = m->mem;
+	return CONVERGE_Z * stats_stddev(s) / sqrt(s->count) / s->mean;
+}
 
-	if ( m->hash ) {
-		hash = malloc(m->size*sizeof(size_t)/sizeof(membash_t));
-		if (hash == NULL){
-			fprintf(stderr,"%s (%d)\n",strerror(errno),
-				errno);
-			exit(errno);
+/*
+ * Repeat until the stop flag goes up. With --converge thread 0 leads
+ * and raises it once its confidence interval narrows to --converge or
+ * it runs out of --time-budget; with --time the monitor raises it at
+ * the deadline. Every thread then catches up to the one that got
+ * furthest, so all of them do the same number of iterations and the
+ * zero sum still holds.
+ */
+static void run_until_stopped(struct membash_thread *t)
+{
+	struct membash *m = t->m;
+	struct membash_thread *all = t - t->id;
+	uint64_t budget = m->time_budget * 1e9;
+	size_t done, most = 0;
+
+	for (done=0; !__atomic_load_n(&m->stop, __ATOMIC_RELAXED); ) {
+		uint64_t start = timer_start(), end;
+
+		t->iter(t);
+		end = timer_stop();
+		if (t->stats)
+			stats_add(t->stats, end > start ? end - start : 0);
+		__atomic_store_n(&t->done, ++done, __ATOMIC_RELAXED);
+
+		if (m->converge && t->id == 0 && done >= m->iters &&
+		    done >= CONVERGE_MIN_ITERS &&
+		    (ci(t->stats) <= m->converge / 100 ||
+		     end - t->start_ns >= budget))
+			__atomic_store_n(&m->stop, 1, __ATOMIC_RELAXED);
+	}
+
+	pthread_barrier_wait(t->barrier);
+	for (unsigned i=0; i<m->threads; i++)
+		if (all[i].done > most)
+			most = all[i].done;
+	while (done < most) {
+		t->iter(t);
+		__atomic_store_n(&t->done, ++done, __ATOMIC_RELAXED);
+	}
+}
+
+static void *thread_main(void *arg)
+{
+	struct membash_thread *t = arg;
+	struct membash *m = t->m;
+
+	pin_thread(t);
+	if (perf_events())
+		perf_open(&t->perf);
+
+	pthread_barrier_wait(t->barrier);
+
+	if (m->warmup) {
+		for (size_t iters=0; iters < m->warmup; iters++)
+			t->iter(t);
+		pthread_barrier_wait(t->barrier);
+	}
+
+	counters_start(t);
+	if (t->id == 0)
+		__atomic_store_n(&m->timed_ns, t->start_ns, __ATOMIC_RELEASE);
+	if (m->converge || m->duration)
+		run_until_stopped(t);
+	else
+		for (size_t done=0; done < m->iters; ) {
+			if (t->stats) {
+				uint64_t start = timer_start(), end;
+
+				t->iter(t);
+				end = timer_stop();
+				stats_add(t->stats,
+					  end > start ? end - start : 0);
+			} else
+				t->iter(t);
+			__atomic_store_n(&t->done, ++done, __ATOMIC_RELAXED);
 		}
-		fisher_yates(hash, m->size/sizeof(membash_t));
+	counters_stop(t);
+
+	__atomic_sub_fetch(&m->running, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+#define MONITOR_POLL_NS 10000000
+
+/*
+ * Sleep until the clock reaches when or every thread has finished,
+ * whichever comes first.
+ */
+static void monitor_sleep(struct membash *m, uint64_t when)
+{
+	uint64_t now;
+
+	while (__atomic_load_n(&m->running, __ATOMIC_ACQUIRE) &&
+	       (now = timer_start()) < when) {
+		uint64_t ns = when - now;
+		struct timespec ts;
+
+		if (ns > MONITOR_POLL_NS)
+			ns = MONITOR_POLL_NS;
+		ts.tv_sec  = ns / 1000000000;
+		ts.tv_nsec = ns % 1000000000;
+		nanosleep(&ts, NULL);
 	}
+}
 
-	gettimeofday(&m->start_time, NULL);
-	for (size_t iters=0; iters < m->iters; iters++){
-		for (size_t i=0; i<(m->size/sizeof(membash_t)); i++) {
-			if ( m->hash )
-				dst = ptr[hash[i]];
-			else
-				dst = ptr[i];
+/*
+ * Wait for thread 0 to start timing, after any --warmup, and return
+ * when it did.
+ */
+static uint64_t monitor_wait_start(struct membash *m)
+{
+	uint64_t start;
+
+	while (!(start = __atomic_load_n(&m->timed_ns, __ATOMIC_ACQUIRE)) &&
+	       __atomic_load_n(&m->running, __ATOMIC_ACQUIRE))
+		monitor_sleep(m, timer_start() + MONITOR_POLL_NS);
+
+	return start ? start : timer_start();
+}
+
+/*
+ * Watch the threads from the main thread while they run: every
+ * --interval print (and record) the rate since the last one, and at
+ * the --time deadline raise the stop flag. Both count from the end of
+ * the warmup. The rates only move when an iteration completes so
+ * intervals shorter than an iteration read as bursts.
+ */
+static void monitor(struct membash *m, struct membash_thread *t,
+		    const char *name)
+{
+	uint64_t start = monitor_wait_start(m), last = start, now, next;
+	uint64_t step = (m->interval ? m->interval : m->duration) * 1e9;
+	uint64_t deadline = start + m->duration * 1e9;
+	size_t bytes, last_bytes = 0;
+	char label[32];
+
+	while (__atomic_load_n(&m->running, __ATOMIC_ACQUIRE)) {
+		next = last + step;
+		if (m->duration && next > deadline)
+			next = deadline;
+		monitor_sleep(m, next);
+
+		now = timer_start();
+		bytes = 0;
+		for (unsigned i=0; i<m->threads; i++)
+			bytes += __atomic_load_n(&t[i].done, __ATOMIC_RELAXED)
+				* t[i].size * m->arrays;
+
+		if (m->interval && !m->quiet && bytes > last_bytes) {
+			struct result *r = results_add(&m->results, name);
+
+			r->size        = m->size;
+			r->threads     = m->threads;
+			r->bytes       = bytes - last_bytes;
+			r->ns          = now - last;
+			r->rate        = r->bytes * 1e9 / r->ns;
+			r->interval_ns = now - start;
+			r->cpu_node    = m->cpu_node;
+			r->mem_node    = m->mem_node;
+
+			snprintf(label, sizeof(label), "%.2fs",
+				 (now - start) / 1e9);
+			fprintf(m->out, "  %-14s: ", label);
+			report_transfer_rate(m->out, last, now,
+					     bytes - last_bytes);
+			fprintf(m->out, "\n");
+			fflush(m->out);
+		}
+
+		if (m->duration && now >= deadline) {
+			/*
+			 * The catch up after the stop is counted in the
+			 * totals but is too short to be an interval.
+			 */
+			__atomic_store_n(&m->stop, 1, __ATOMIC_RELAXED);
+			monitor_sleep(m, UINT64_MAX);
+			break;
 		}
+		last = now;
+		last_bytes = bytes;
 	}
-	gettimeofday(&m->end_time, NULL);
-	fprintf(stdout, "Read (blockcpy) : ");
-	report_transfer_rate(stdout, &m->start_time,
-			     &m->end_time,
-			     m->iters*m->size);
-	fprintf(stdout, "\n");
-	(void) dst; //suppress set but not used warning
-	if (m->hash)
-		free(hash);
-	return 0;
 }
 
-static void cleanup(struct membash *m)
+/*
+ * Merge every thread's per iteration times, keep their spread with the
+ * result for --compare and, with --percentiles, report the spread of
+ * rates. With more than one thread these are the rates of each
+ * thread's slice, which are all within an alignment unit of
+ * m->size/m->threads, rather than of the whole buffer.
+ */
+static void merge_samples(struct membash *m, struct membash_thread *t)
 {
-	if ( m->mmap ){
-		munmap(m->mem, m->size);
-		close(m->mmapfd);
+	for (unsigned i=1; i<m->threads; i++) {
+		stats_merge(t[0].stats, t[i].stats);
+		free(t[i].stats);
+		t[i].stats = NULL;
 	}
-	else
-		free(m->mem);
+
+	/*
+	 * The threads run their iterations side by side, so the samples
+	 * of one run only average over m->done independent iterations.
+	 */
+	m->iterations = m->done;
+	m->rate_cv = 0;
+	if (t[0].stats->mean > 0)
+		m->rate_cv = stats_stddev(t[0].stats) / t[0].stats->mean;
 }
 
-int main(int argc, char **argv)
+static void report_samples(struct membash *m, struct membash_thread *t)
 {
-	struct membash cfg;
+	double bytes = (double)m->size * m->arrays / m->threads;
 
-	int args = argconfig_parse(argc, argv, program_desc, command_line_options,
-				   &defaults, &cfg, sizeof(cfg));
-	if (args != 0) {
-		argconfig_print_help(argv[0], program_desc, command_line_options);
-		return 1;
+	if (m->percentiles) {
+		fprintf(m->out, "  %-14s: ", m->threads > 1 ? "per thread" :
+			"per iteration");
+		report_rate_percentiles(m->out, t[0].stats, bytes);
+		fprintf(m->out, "\n");
+		report_rate_histogram(m->out, "    ", t[0].stats, bytes);
 	}
 
-	if (cfg.hash && !cfg.blockcpy){
-		fprintf(stderr, "Can only use --hash when --blockcpy is set.\n");
-		exit(-1);
+	free(t[0].stats);
+	t[0].stats = NULL;
+}
+
+/*
+ * Run iter over every slice of the buffer, one thread per slice, all
+ * released together from a common barrier. The aggregate rate is
+ * measured from the first thread to start to the last one to finish.
+ */
+static struct membash_thread *run_threads(struct membash *m,
+					  const char *name, size_t align,
+					  void (* iter)(struct membash_thread *))
+{
+	struct membash_thread *t;
+	pthread_barrier_t barrier;
+	int ret;
+
+	t = calloc(m->threads, sizeof(*t));
+	if (t == NULL){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
 	}
 
-	if (cfg.seed==0)
-		cfg.seed = time(NULL);
-	srand(cfg.seed);
+	pthread_barrier_init(&barrier, NULL, m->threads);
+	m->stop = 0;
+	m->running = m->threads;
+	m->timed_ns = 0;
 
-	setup(&cfg);
+	for (unsigned i=0; i<m->threads; i++) {
+		t[i].m       = m;
+		t[i].id      = i;
+		t[i].barrier = &barrier;
+		t[i].iter    = iter;
+		slice(m, &t[i], align);
 
-#ifndef __powerpc64__
-	if ( cfg.fence )
-		asm volatile("mfence" ::: "memory");
-#endif
-	cfg.run  = run_dumb;
-	cfg.run(&cfg);
+		if (m->sample || m->converge) {
+			t[i].stats = malloc(sizeof(*t[i].stats));
+			if (t[i].stats == NULL){
+				fprintf(stderr,"%s (%d)\n",strerror(errno),
+					errno);
+				exit(errno);
+			}
+			stats_init(t[i].stats);
+		}
 
-	cfg.run  = run_memcpy;
-	cfg.run(&cfg);
+		ret = pthread_create(&t[i].thread, NULL, thread_main, &t[i]);
+		if (ret){
+			fprintf(stderr,"%s (%d)\n",strerror(ret),
+				ret);
+			exit(ret);
+		}
+	}
 
-	if ( cfg.blockcpy ){
-		cfg.run  = run_blockcpy;
-		cfg.run(&cfg);
+	if ((m->interval && !m->quiet) || m->duration)
+		monitor(m, t, name);
+
+	for (unsigned i=0; i<m->threads; i++)
+		pthread_join(t[i].thread, NULL);
+
+	pthread_barrier_destroy(&barrier);
+
+	merge_counters(m, t);
+
+	m->done = t[0].done;
+	m->ci = m->converge ? ci(t[0].stats) : 0;
+	m->rate = m->done*m->size*m->arrays /
+		elapsed(m->start_ns, m->end_ns);
+	m->iterations = 0;
+	m->rate_cv = 0;
+	if (t[0].stats)
+		merge_samples(m, t);
+
+	if (m->quiet) {
+		free(t[0].stats);
+		t[0].stats = NULL;
+		return t;
 	}
 
-	cleanup(&cfg);
-	return 0;
+	add_result(m, name, m->size, m->done*m->size*m->arrays);
+	fprintf(m->out, "%-16s: ", name);
+	report_transfer_rate(m->out, m->start_ns,
+			     m->end_ns,
+			     m->done*m->size*m->arrays);
+	fprintf(m->out, "\n");
+
+	if (m->converge)
+		fprintf(m->out, "  %-14s: +/-%.2f%% (95%% CI) over %zu "
+			"iterations\n", m->ci <= m->converge / 100 ?
+			"converged" : "not converged", m->ci * 100, m->done);
+	print_counters(m, m->done*m->size*m->arrays);
+
+	if (m->threads > 1)
+		for (unsigned i=0; i<m->threads; i++) {
+			fprintf(m->out, "  thread %-6u : ", i);
+			report_transfer_rate(m->out, t[i].start_ns,
+					     t[i].end_ns,
+					     m->done*t[i].size*m->arrays);
+			if (m->cpus)
+				fprintf(m->out, "   cpu %d",
+					m->cpus[i % m->ncpus]);
+			fprintf(m->out, "\n");
+		}
+
+	if (t[0].stats)
+		report_samples(m, t);
+
+	return t;
+}
+
+static void memcpy_iter(struct membash_thread *t)
+{
+	char *src = t->m->src ? t->m->src : t->m->mem;
+
+	t->m->copy((char *)t->m->dst + t->offset, src + t->offset,
+		   t->size);
+}
+
+/*
+ * Pick the memcpy buffers for --direction. The test buffer is the
+ * source whenever it is on the right side, otherwise the DRAM side
+ * gets a fresh buffer. Copying from DRAM into --mmap without an
+ * --mmap-dst overwrites the test buffer.
+ */
+static void memcpy_buffers(struct membash *m)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	int dir = m->direction_kind;
+
+	m->src = NULL;
+	if ((dir & DIRECTION_SRC_IOMEM) || !m->mmap)
+		m->src = m->mem;
+
+	/*
+	 * Fault in the destination up front, or whichever copy runs first
+	 * pays for every page inside its timed region. A mapped one only
+	 * needs a write to each page, not a pass over all of IOMEM.
+	 */
+	if (dir & DIRECTION_DST_IOMEM) {
+		m->dst = m->dst_map ? m->dst_map : m->mem;
+		for (size_t off=0; off<m->size; off+=page)
+			((volatile char *)m->dst)[off] = 0;
+	}
+	else if ((m->dst = alloc_buffer(m, m->size)) != NULL)
+		memset(m->dst, 0, m->size);
+
+	if (m->src == NULL) {
+		m->src = alloc_buffer(m, m->size);
+		if (m->src != NULL)
+			memset(m->src, 0, m->size);
+	}
+
+	if ( m->src == NULL || m->dst == NULL ){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
+	}
+
+	if (m->dst == m->mem)
+		m->dirty = 1;
+}
+
+static void memcpy_free(struct membash *m)
+{
+	if (m->src != m->mem)
+		free_buffer(m, m->src, m->size);
+	if (m->dst != m->mem && m->dst != m->dst_map)
+		free_buffer(m, m->dst, m->size);
+	m->src = m->dst = NULL;
+}
+
+/*
+ * Without --copy-engine this is the original glibc memcpy run. With
+ * it the run is labelled by the engine and --copy-engine all tries
+ * every one, reporting the ones this cpu lacks. Other modes reusing
+ * memcpy_iter only ever see the one engine.
+ */
+static int run_memcpy(struct membash *m)
+{
+	simd_copy_fn copy = m->copy;
+	const char *dir = "";
+	char name[32];
+
+	memcpy_buffers(m);
+	if ( m->direction || m->mmap_dst )
+		dir = direction_names[m->direction_kind];
+
+	if ( !m->copy_engine && !*dir )
+		free(run_threads(m, "Read (memcpy)   ", 64, memcpy_iter));
+	else if ( !m->copy_engine ) {
+		snprintf(name, sizeof(name), "Copy %s", dir);
+		free(run_threads(m, name, 64, memcpy_iter));
+	}
+	else if ( !m->copy_all || m->quiet ) {
+		snprintf(name, sizeof(name), "Copy %s%s(%s)", dir,
+			 *dir ? " " : "", m->copy_engine);
+		free(run_threads(m, name, 64, memcpy_iter));
+	}
+	else
+		for (int e=0; e<COPY_COUNT; e++) {
+			snprintf(name, sizeof(name), "Copy %s%s(%s)", dir,
+				 *dir ? " " : "", simd_copy_name(e));
+			m->copy = simd_get_copy(e);
+			if (m->copy == NULL)
+				fprintf(m->out, "%-16s: not supported\n", name);
+			else
+				free(run_threads(m, name, 64, memcpy_iter));
+		}
+	m->copy = copy;
+
+	memcpy_free(m);
+	return 0;
+}
+
+static void dumb_iter(struct membash_thread *t)
+{
+	unsigned sum = 0, *ptr;
+
+	ptr = (unsigned *)((char *)t->m->mem + t->offset);
+
+	for (size_t i=0; i<(t->size/sizeof(unsigned)); i++)
+		sum += ptr[i];
+	t->sum += sum;
+}
+
+/*
+ * Each slice has its own non-zero sum but across all the threads
+ * every iteration must still add up to zero.
+ */
+static void check_sum(struct membash *m, struct membash_thread *t)
+{
+	unsigned sum = 0;
+
+	for (unsigned i=0; i<m->threads; i++)
+		sum += t[i].sum;
+	free(t);
+
+	if ( sum ){
+		fprintf(stderr,"sum did not add to zero (%u)!\n",
+			sum);
+		exit(1);
+	}
+}
+
+static int run_dumb(struct membash *m)
+{
+	refill(m);
+	check_sum(m, run_threads(m, "Read (dumb)     ", 64, dumb_iter));
+	return 0;
+}
+
+static void simd_iter(struct membash_thread *t)
+{
+	unsigned *ptr = (unsigned *)((char *)t->m->mem + t->offset);
+
+	t->sum += t->m->simd_sum(ptr, t->size/sizeof(unsigned));
+}
+
+static int run_simd(struct membash *m)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "Read (%s)", m->simd);
+	refill(m);
+	check_sum(m, run_threads(m, name, 64, simd_iter));
+	return 0;
+}
+
+static void write_iter(struct membash_thread *t)
+{
+	t->m->writer((char *)t->m->mem + t->offset, t->size);
+}
+
+static int run_write(struct membash *m, const char *name,
+		     simd_write_fn writer)
+{
+	m->rate = 0;
+	if (writer == NULL) {
+		if (!m->quiet)
+			fprintf(m->out, "%-16s: not supported\n", name);
+		return -1;
+	}
+
+	m->writer = writer;
+	m->dirty  = 1;
+	free(run_threads(m, name, 64, write_iter));
+	return 0;
+}
+
+static int run_store(struct membash *m)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "Write (%s)", m->simd);
+	return run_write(m, name, simd_get_write(m->simd_isa));
+}
+
+static int run_store_nt(struct membash *m)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "WriteNT (%s)", m->simd);
+	return run_write(m, name, simd_get_write_nt(m->simd_isa));
+}
+
+static int run_stosb(struct membash *m)
+{
+	return run_write(m, "Write (stosb)", simd_get_write_stosb());
+}
+
+/*
+ * STREAM kernels over three arrays of doubles. The thread slices are
+ * taken over the bytes of one array and m->arrays tells run_threads
+ * how many arrays each kernel moves so the byte counts match what
+ * STREAM itself reports.
+ */
+#define STREAM_SCALAR 3.0
+
+static void stream_copy_iter(struct membash_thread *t)
+{
+	size_t first = t->offset / sizeof(double);
+	size_t last  = first + t->size / sizeof(double);
+	double * restrict a = t->m->stream_a, * restrict c = t->m->stream_c;
+
+	for (size_t j=first; j<last; j++)
+		c[j] = a[j];
+}
+
+static void stream_scale_iter(struct membash_thread *t)
+{
+	size_t first = t->offset / sizeof(double);
+	size_t last  = first + t->size / sizeof(double);
+	double * restrict b = t->m->stream_b, * restrict c = t->m->stream_c;
+
+	for (size_t j=first; j<last; j++)
+		b[j] = STREAM_SCALAR * c[j];
+}
+
+static void stream_add_iter(struct membash_thread *t)
+{
+	size_t first = t->offset / sizeof(double);
+	size_t last  = first + t->size / sizeof(double);
+	double * restrict a = t->m->stream_a, * restrict b = t->m->stream_b;
+	double * restrict c = t->m->stream_c;
+
+	for (size_t j=first; j<last; j++)
+		c[j] = a[j] + b[j];
+}
+
+static void stream_triad_iter(struct membash_thread *t)
+{
+	size_t first = t->offset / sizeof(double);
+	size_t last  = first + t->size / sizeof(double);
+	double * restrict a = t->m->stream_a, * restrict b = t->m->stream_b;
+	double * restrict c = t->m->stream_c;
+
+	for (size_t j=first; j<last; j++)
+		a[j] = b[j] + STREAM_SCALAR * c[j];
+}
+
+static double *stream_array(struct membash *m, char name, size_t bytes)
+{
+	double *array;
+
+	if (!strchr(m->stream_dram, name))
+		return (double *)((char *)m->mem + (name - 'a') * bytes);
+
+	array = alloc_buffer(m, bytes);
+	if (array == NULL){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
+	}
+	return array;
+}
+
+static int run_stream(struct membash *m)
+{
+	size_t msize = m->size, bytes = (m->size / 3) & ~(size_t)63;
+	size_t n = bytes / sizeof(double);
+	double a = 1.0, b = 2.0, c = 0.0;
+
+	if (n == 0){
+		fprintf(stderr,"need at least %d bytes for STREAM!\n",
+			3*64);
+		exit(1);
+	}
+
+	m->stream_a = stream_array(m, 'a', bytes);
+	m->stream_b = stream_array(m, 'b', bytes);
+	m->stream_c = stream_array(m, 'c', bytes);
+	for (size_t j=0; j<n; j++) {
+		m->stream_a[j] = a;
+		m->stream_b[j] = b;
+		m->stream_c[j] = c;
+	}
+	m->dirty = 1;
+
+	m->size = bytes;
+	m->arrays = 2;
+	free(run_threads(m, "Copy (stream)", 64, stream_copy_iter));
+	free(run_threads(m, "Scale (stream)", 64, stream_scale_iter));
+	m->arrays = 3;
+	free(run_threads(m, "Add (stream)", 64, stream_add_iter));
+	free(run_threads(m, "Triad (stream)", 64, stream_triad_iter));
+	m->arrays = 1;
+	m->size = msize;
+
+	/*
+	 * Every kernel only writes an array it does not read, so however
+	 * many iterations ran the arrays must end up as below.
+	 */
+	c = a;
+	b = STREAM_SCALAR * c;
+	c = a + b;
+	a = b + STREAM_SCALAR * c;
+	for (size_t j=0; j<n; j++)
+		if (m->stream_a[j] != a || m->stream_b[j] != b ||
+		    m->stream_c[j] != c) {
+			fprintf(stderr,"STREAM validation failed at "
+				"element %zd!\n", j);
+			exit(1);
+		}
+
+	if (strchr(m->stream_dram, 'a'))
+		free_buffer(m, m->stream_a, bytes);
+	if (strchr(m->stream_dram, 'b'))
+		free_buffer(m, m->stream_b, bytes);
+	if (strchr(m->stream_dram, 'c'))
+		free_buffer(m, m->stream_c, bytes);
+	m->stream_a = m->stream_b = m->stream_c = NULL;
+
+	return 0;
+}
+
+/*
+ * Make the compiler finish copying a block into x each iteration: its
+ * address escapes into the asm and the asm may read any memory.
+ * Locals whose address is never taken, like the copies of the index
+ * array pointer and the feistel keys below, stay in registers.
+ */
+#define BLOCKCPY_SINK(x) __asm__ volatile("" : : "r" (&(x)) : "memory")
+
+#define BLOCKCPY_LOOP(block_t)						\
+	do {								\
+		const block_t *ptr = m->mem;				\
+		const size_t *idx = m->hash_idx;			\
+		struct feistel f = m->feistel;				\
+		size_t first = t->offset/sizeof(block_t);		\
+		size_t last = first + t->size/sizeof(block_t);		\
+		block_t dst;						\
+									\
+		if ( !m->hash )						\
+			for (size_t i=first; i<last; i++) {		\
+				dst = ptr[i];				\
+				BLOCKCPY_SINK(dst);			\
+			}						\
+		else if ( m->permute_kind == PERMUTE_FEISTEL )		\
+			for (size_t i=first; i<last; i++) {		\
+				dst = ptr[feistel(&f, i)];		\
+				BLOCKCPY_SINK(dst);			\
+			}						\
+		else							\
+			for (size_t i=first; i<last; i++) {		\
+				dst = ptr[idx[i]];			\
+				BLOCKCPY_SINK(dst);			\
+			}						\
+	} while (0)
+
+/*
+ * The generic path for any --blockcpy: the block is a variable length
+ * array so each copy is a call to memcpy.
+ */
+static void blockcpy_iter(struct membash_thread *t)
+{
+	struct membash *m = t->m;
+	typedef struct { char a[m->blockcpy]; } membash_t;
+
+	BLOCKCPY_LOOP(membash_t);
+}
+
+/*
+ * Power of two blocks from 1B to 4KiB get a kernel each with the size
+ * known at compile time, so the copy is inlined as fixed width moves.
+ */
+#define DEFINE_BLOCKCPY(N)						\
+static void blockcpy_##N(struct membash_thread *t)			\
+{									\
+	struct membash *m = t->m;					\
+	typedef struct { char a[N]; } block_##N##_t;			\
+									\
+	BLOCKCPY_LOOP(block_##N##_t);					\
+}
+
+DEFINE_BLOCKCPY(1)
+DEFINE_BLOCKCPY(2)
+DEFINE_BLOCKCPY(4)
+DEFINE_BLOCKCPY(8)
+DEFINE_BLOCKCPY(16)
+DEFINE_BLOCKCPY(32)
+DEFINE_BLOCKCPY(64)
+DEFINE_BLOCKCPY(128)
+DEFINE_BLOCKCPY(256)
+DEFINE_BLOCKCPY(512)
+DEFINE_BLOCKCPY(1024)
+DEFINE_BLOCKCPY(2048)
+DEFINE_BLOCKCPY(4096)
+
+static void (* const blockcpy_fns[])(struct membash_thread *) = {
+	blockcpy_1,    blockcpy_2,    blockcpy_4,    blockcpy_8,
+	blockcpy_16,   blockcpy_32,   blockcpy_64,   blockcpy_128,
+	blockcpy_256,  blockcpy_512,  blockcpy_1024, blockcpy_2048,
+	blockcpy_4096,
+};
+
+#define BLOCKCPY_FNS (sizeof(blockcpy_fns)/sizeof(blockcpy_fns[0]))
+
+static void (*blockcpy_kernel(size_t size))(struct membash_thread *)
+{
+	if (size && !(size & (size-1)) && size <= (1UL << (BLOCKCPY_FNS-1)))
+		return blockcpy_fns[__builtin_ctzl(size)];
+
+	return blockcpy_iter;
+}
+
+/*
+ * With --permute both the index and feistel orders run back to back
+ * over the same blocks, so the cost of loading the index array shows
+ * up as the difference between the two.
+ */
+static int run_blockcpy(struct membash *m)
+{
+	size_t blocks = m->size/m->blockcpy;
+	int kind = m->permute_kind;
+
+	if ( m->hash && kind != PERMUTE_FEISTEL ) {
+		m->hash_idx = malloc(blocks*sizeof(size_t));
+		if (m->hash_idx == NULL){
+			fprintf(stderr,"%s (%d)\n",strerror(errno),
+				errno);
+			exit(errno);
+		}
+		fisher_yates(m->hash_idx, blocks);
+
+		m->permute_kind = PERMUTE_INDEX;
+		free(run_threads(m, "Read (blockcpy) ", m->blockcpy,
+				 m->blockcpy_fn));
+
+		free(m->hash_idx);
+		m->hash_idx = NULL;
+	}
+
+	if ( m->hash && kind != PERMUTE_INDEX ) {
+		feistel_init(&m->feistel, blocks, m->seed);
+
+		m->permute_kind = PERMUTE_FEISTEL;
+		free(run_threads(m, "Read (feistel)  ", m->blockcpy,
+				 m->blockcpy_fn));
+	}
+
+	if ( !m->hash )
+		free(run_threads(m, "Read (blockcpy) ", m->blockcpy,
+				 m->blockcpy_fn));
+
+	m->permute_kind = kind;
+	return 0;
+}
+
+#define LATENCY_STRIDE   64
+#define LATENCY_MIN_SIZE 4096
+#define LATENCY_LOADS    (1 << 20)
+
+#define MLP_MAX          32
+
+/*
+ * Link the first size bytes of the buffer into random cycles of cache
+ * line sized nodes: the order of the nodes in a fisher-yates
+ * permutation is the order they are visited in, so every load depends
+ * on the one before and the prefetchers have nothing to work with.
+ * The permutation is cut into m->chains pieces and each piece is
+ * closed into its own cycle, giving independent chains for the MLP
+ * test.
+ */
+static void build_chain(struct membash *m, size_t size)
+{
+	size_t nodes = size / LATENCY_STRIDE;
+	char *mem = m->mem;
+	size_t *perm;
+
+	if (nodes < m->chains){
+		fprintf(stderr,"need at least %zd bytes to chase %u "
+			"pointer chains!\n", m->chains*(size_t)LATENCY_STRIDE,
+			m->chains);
+		exit(1);
+	}
+
+	perm = malloc(nodes*sizeof(*perm));
+	if (perm == NULL){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
+	}
+	fisher_yates(perm, nodes);
+
+	for (unsigned c=0; c<m->chains; c++) {
+		size_t first = c*nodes/m->chains;
+		size_t last  = (c+1)*nodes/m->chains;
+
+		for (size_t i=first; i<last; i++)
+			*(void **)&mem[perm[i]*LATENCY_STRIDE] =
+				&mem[perm[i+1 < last ? i+1 : first]*LATENCY_STRIDE];
+		m->chase_heads[c] = &mem[perm[first]*LATENCY_STRIDE];
+	}
+
+	m->dirty = 1;
+	free(perm);
+}
+
+/*
+ * One chase loop per chain count so the compiler can keep every chain
+ * in a register and interleave their loads within each step.
+ */
+#define DEFINE_CHASE(K)						\
+static void chase_##K(void **heads, size_t steps)		\
+{								\
+	void **p[K];						\
+								\
+	for (int k=0; k<K; k++)					\
+		p[k] = heads[k];				\
+	for (size_t i=0; i<steps; i++) {			\
+		_Pragma("GCC unroll 32")			\
+		for (int k=0; k<K; k++)				\
+			p[k] = *p[k];				\
+	}							\
+	for (int k=0; k<K; k++)					\
+		heads[k] = p[k];				\
+}
+
+DEFINE_CHASE(1)  DEFINE_CHASE(2)  DEFINE_CHASE(3)  DEFINE_CHASE(4)
+DEFINE_CHASE(5)  DEFINE_CHASE(6)  DEFINE_CHASE(7)  DEFINE_CHASE(8)
+DEFINE_CHASE(9)  DEFINE_CHASE(10) DEFINE_CHASE(11) DEFINE_CHASE(12)
+DEFINE_CHASE(13) DEFINE_CHASE(14) DEFINE_CHASE(15) DEFINE_CHASE(16)
+DEFINE_CHASE(17) DEFINE_CHASE(18) DEFINE_CHASE(19) DEFINE_CHASE(20)
+DEFINE_CHASE(21) DEFINE_CHASE(22) DEFINE_CHASE(23) DEFINE_CHASE(24)
+DEFINE_CHASE(25) DEFINE_CHASE(26) DEFINE_CHASE(27) DEFINE_CHASE(28)
+DEFINE_CHASE(29) DEFINE_CHASE(30) DEFINE_CHASE(31) DEFINE_CHASE(32)
+
+static void (* const chase_fns[MLP_MAX])(void **, size_t) = {
+	chase_1,  chase_2,  chase_3,  chase_4,
+	chase_5,  chase_6,  chase_7,  chase_8,
+	chase_9,  chase_10, chase_11, chase_12,
+	chase_13, chase_14, chase_15, chase_16,
+	chase_17, chase_18, chase_19, chase_20,
+	chase_21, chase_22, chase_23, chase_24,
+	chase_25, chase_26, chase_27, chase_28,
+	chase_29, chase_30, chase_31, chase_32,
+};
+
+#define LATENCY_BATCH    256
+
+/*
+ * When sampling, time the chase in batches of LATENCY_BATCH steps,
+ * short enough to catch a stall but long enough to amortise the
+ * clock read, and record each batch's ps per step.
+ */
+static void chase_iter(struct membash_thread *t)
+{
+	struct membash *m = t->m;
+	uint64_t start, end;
+	size_t steps;
+
+	if (m->chase_stats == NULL) {
+		chase_fns[m->chains-1](m->chase_heads, m->chase_loads);
+		return;
+	}
+
+	for (size_t i=0; i<m->chase_loads; i+=steps) {
+		steps = m->chase_loads - i;
+		if (steps > LATENCY_BATCH)
+			steps = LATENCY_BATCH;
+
+		start = timer_start();
+		chase_fns[m->chains-1](m->chase_heads, steps);
+		end = timer_stop();
+		stats_add(m->chase_stats,
+			  end > start ? (end - start) * 1000 / steps : 0);
+	}
+}
+
+/*
+ * Chase m->chains chains over the first size bytes of the buffer from
+ * a single thread (on the first placement cpu, if any) and return the
+ * average time per step, ie. the latency each chain sees per load.
+ */
+static double chase(struct membash *m, size_t size)
+{
+	unsigned threads = m->threads, quiet = m->quiet;
+	size_t msize = m->size;
+	void *heads[MLP_MAX];
+
+	m->chase_heads = heads;
+	build_chain(m, size);
+
+	m->chase_loads = size / LATENCY_STRIDE;
+	if (m->chase_loads < LATENCY_LOADS)
+		m->chase_loads = LATENCY_LOADS;
+	m->chase_loads /= m->chains;
+
+	m->threads = 1;
+	m->quiet = 1;
+	m->size = size;
+	free(run_threads(m, "", LATENCY_STRIDE, chase_iter));
+	m->threads = threads;
+	m->quiet = quiet;
+	m->size = msize;
+	m->chase_heads = NULL;
+
+	return elapsed(m->start_ns, m->end_ns) /
+		(m->done * m->chase_loads);
+}
+
+static struct result *add_chase_result(struct membash *m,
+				       const char *kernel, size_t size)
+{
+	size_t loads = m->done * m->chase_loads * m->chains;
+	struct result *r = add_result(m, kernel, size,
+				      loads * LATENCY_STRIDE);
+
+	r->threads    = 1;
+	r->loads      = loads;
+	r->latency_ns = r->ns / (double)(m->done * m->chase_loads);
+
+	return r;
+}
+
+static int run_latency(struct membash *m)
+{
+	double size_d;
+	const char *suffix;
+	char name[32];
+	size_t size = LATENCY_MIN_SIZE;
+	struct stats *stats = NULL;
+
+	if (size > m->size)
+		size = m->size;
+
+	if (m->percentiles) {
+		stats = malloc(sizeof(*stats));
+		if (stats == NULL){
+			fprintf(stderr,"%s (%d)\n",strerror(errno),
+				errno);
+			exit(errno);
+		}
+	}
+
+	for (;;) {
+		if (stats) {
+			stats_init(stats);
+			m->chase_stats = stats;
+		}
+		chase(m, size);
+		m->chase_stats = NULL;
+
+		size_d = size;
+		suffix = suffix_dbinary_get(&size_d);
+		snprintf(name, sizeof(name), "Latency (%.0f%sB)",
+			 size_d, suffix);
+		add_chase_result(m, name, size);
+		fprintf(m->out, "%-16s: ", name);
+		report_load_latency(m->out, m->start_ns, m->end_ns,
+				    m->done * m->chase_loads);
+		fprintf(m->out, "\n");
+		print_counters(m, m->done * m->chase_loads * LATENCY_STRIDE);
+
+		if (stats) {
+			fprintf(m->out, "  %-14s: ", "per batch");
+			report_latency(m->out, stats, 1e-12);
+			fprintf(m->out, "\n");
+		}
+
+		if (size == m->size)
+			break;
+		size *= 2;
+		if (size > m->size)
+			size = m->size;
+	}
+
+	free(stats);
+	return 0;
+}
+
+/*
+ * Chase 1 up to m->mlp independent chains over the whole buffer. With
+ * enough chains the per chain latency starts to climb and the
+ * effective bandwidth stops growing: that is the number of misses the
+ * core (or the device behind --mmap) can keep outstanding.
+ */
+static int run_mlp(struct membash *m)
+{
+	double latency;
+	char name[32];
+	size_t loads;
+
+	for (m->chains=1; m->chains<=m->mlp; m->chains++) {
+		latency = chase(m, m->size);
+		loads = m->done * m->chase_loads * m->chains;
+
+		snprintf(name, sizeof(name), "MLP (%u chains)", m->chains);
+		add_chase_result(m, name, m->size);
+		fprintf(m->out, "%-16s: ", name);
+		report_transfer_rate(m->out, m->start_ns, m->end_ns,
+				     loads * LATENCY_STRIDE);
+		fprintf(m->out, "   %6.2fns/load\n", latency * 1e9);
+		print_counters(m, loads * LATENCY_STRIDE);
+	}
+	m->chains = 1;
+
+	return 0;
+}
+
+#define WSS_KNEE 1.25
+
+/*
+ * Print the sizes at which a curve gets more than WSS_KNEE worse than
+ * the size before it. A run of consecutive jumps is a single knee and
+ * is reported at the last size before it started, which is roughly
+ * the capacity of the cache being overflowed.
+ */
+static void print_knees(FILE *outf, const char *name, size_t *sizes,
+			double *val, int count, int higher_is_worse)
+{
+	double size_d, ratio;
+	const char *suffix;
+	int in_knee = 0;
+
+	fprintf(outf, "%-16s:", name);
+	for (int i=1; i<count; i++) {
+		ratio = higher_is_worse ? val[i] / val[i-1] :
+			val[i-1] / val[i];
+		if (ratio > WSS_KNEE && !in_knee) {
+			size_d = sizes[i-1];
+			suffix = suffix_dbinary_get(&size_d);
+			fprintf(outf, " %.0f%sB", size_d, suffix);
+		}
+		in_knee = ratio > WSS_KNEE;
+	}
+	fprintf(outf, "\n");
+}
+
+/*
+ * Run the simd read, memcpy and latency kernels over the first 4KiB,
+ * 8KiB, ... of the buffer up to --size, without reallocating it. Each
+ * size gets enough iterations to move as many bytes as one run over
+ * the full buffer would, so the small sizes are still timeable.
+ */
+static int run_wss(struct membash *m)
+{
+	size_t msize = m->size, miters = m->iters;
+	int count = 0, max_count = 2;
+	double size_d;
+	const char *suffix;
+	char name[32];
+
+	for (size_t size=LATENCY_MIN_SIZE; size<msize; size*=2)
+		max_count++;
+
+	size_t sizes[max_count];
+	double read[max_count], copy[max_count], lat[max_count];
+
+	m->dst = alloc_buffer(m, msize);
+	if ( m->dst == NULL ){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
+	}
+	memset(m->dst, 0, msize);
+
+	m->quiet = 1;
+	for (size_t size=LATENCY_MIN_SIZE < msize ? LATENCY_MIN_SIZE : msize;;
+	     size*=2) {
+		if (size > msize)
+			size = msize;
+
+		m->size  = size;
+		m->iters = (miters*msize + size - 1) / size;
+
+		free(run_threads(m, "", 64, simd_iter));
+		read[count] = m->rate;
+		add_result(m, "WSS (read)", size, m->done*size);
+		free(run_threads(m, "", 64, memcpy_iter));
+		copy[count] = m->rate;
+		add_result(m, "WSS (copy)", size, m->done*size);
+
+		m->iters = miters;
+		m->size  = msize;
+		lat[count] = chase(m, size);
+		add_chase_result(m, "WSS (latency)", size);
+		sizes[count++] = size;
+
+		if (size == msize)
+			break;
+	}
+	m->quiet = 0;
+
+	free_buffer(m, m->dst, msize);
+	m->dst = NULL;
+
+	fprintf(m->out, "WSS sweep       :  read GB/s  copy GB/s  latency ns\n");
+	for (int i=0; i<count; i++) {
+		size_d = sizes[i];
+		suffix = suffix_dbinary_get(&size_d);
+		snprintf(name, sizeof(name), "%.0f%sB", size_d, suffix);
+		fprintf(m->out, "  %-14s: %10.2f %10.2f %11.2f\n", name,
+			read[i] / 1e9, copy[i] / 1e9, lat[i] * 1e9);
+	}
+
+	print_knees(m->out, "Latency knees", sizes, lat, count, 1);
+	print_knees(m->out, "Read knees", sizes, read, count, 0);
+	print_knees(m->out, "Copy knees", sizes, copy, count, 0);
+
+	return 0;
+}
+
+#define SWEEP_KNEE 0.95
+
+static const struct {
+	const char *name;
+	int (* run)(struct membash *);
+} sweep_kernels[] = {
+	{"dumb",     run_dumb},
+	{"simd",     run_simd},
+	{"memcpy",   run_memcpy},
+	{"blockcpy", run_blockcpy},
+	{"store",    run_store},
+	{"storent",  run_store_nt},
+	{"stosb",    run_stosb},
+};
+
+#define SWEEP_KERNELS (sizeof(sweep_kernels)/sizeof(sweep_kernels[0]))
+
+/*
+ * Run every kernel at 1 up to m->threads threads over the same
+ * buffer and print the aggregate bandwidth for each thread count. The
+ * knee is the smallest thread count that gets within SWEEP_KNEE of
+ * the best bandwidth that kernel achieved.
+ */
+static int run_sweep(struct membash *m)
+{
+	unsigned max_threads = m->threads;
+	double rates[max_threads][SWEEP_KERNELS];
+	double peak;
+	unsigned knee;
+	char name[32];
+
+	m->quiet = 1;
+	for (unsigned n=1; n<=max_threads; n++) {
+		m->threads = n;
+		for (unsigned k=0; k<SWEEP_KERNELS; k++) {
+			rates[n-1][k] = 0;
+			if (sweep_kernels[k].run == run_blockcpy && !m->blockcpy)
+				continue;
+			if (sweep_kernels[k].run(m))
+				continue;
+			rates[n-1][k] = m->rate;
+			snprintf(name, sizeof(name), "Sweep (%s)",
+				 sweep_kernels[k].name);
+			add_result(m, name, m->size,
+				   m->done*m->size*m->arrays);
+		}
+	}
+	m->threads = max_threads;
+	m->quiet = 0;
+
+	fprintf(m->out, "Sweep (GB/s)    :");
+	for (unsigned k=0; k<SWEEP_KERNELS; k++)
+		if (sweep_kernels[k].run != run_blockcpy || m->blockcpy)
+			fprintf(m->out, " %9s", sweep_kernels[k].name);
+	fprintf(m->out, "\n");
+
+	for (unsigned n=1; n<=max_threads; n++) {
+		fprintf(m->out, "  %-4u threads  :", n);
+		for (unsigned k=0; k<SWEEP_KERNELS; k++) {
+			if (sweep_kernels[k].run == run_blockcpy && !m->blockcpy)
+				continue;
+			if (rates[n-1][k] > 0)
+				fprintf(m->out, " %9.2f", rates[n-1][k] / 1e9);
+			else
+				fprintf(m->out, " %9s", "-");
+		}
+		fprintf(m->out, "\n");
+	}
+
+	fprintf(m->out, "Knee (threads)  :");
+	for (unsigned k=0; k<SWEEP_KERNELS; k++) {
+		if (sweep_kernels[k].run == run_blockcpy && !m->blockcpy)
+			continue;
+		peak = 0;
+		for (unsigned n=0; n<max_threads; n++)
+			if (rates[n][k] > peak)
+				peak = rates[n][k];
+		if (peak == 0) {
+			fprintf(m->out, " %9s", "-");
+			continue;
+		}
+		for (knee=0; rates[knee][k] < SWEEP_KNEE*peak; knee++);
+		fprintf(m->out, " %9u", knee+1);
+	}
+	fprintf(m->out, "\n");
+
+	return 0;
+}
+
+static void setup_placement(struct membash *m)
+{
+	struct topology_cpu *topo;
+	int count;
+
+	count = topology_read(&topo);
+	if (count <= 0){
+		fprintf(stderr, "could not read the cpu topology!\n");
+		exit(1);
+	}
+
+	m->cpus = malloc(count*sizeof(*m->cpus));
+	if (m->cpus == NULL){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
+	}
+
+	if (topology_place(m->placement, topo, count, m->cpus)){
+		fprintf(stderr, "Unknown placement policy '%s'.\n",
+			m->placement);
+		exit(-1);
+	}
+	m->ncpus = count;
+	free(topo);
+}
+
+/*
+ * Work out the cpus to run on for a given node: the placement order
+ * restricted to that node, or the node's cpus as listed by sysfs when
+ * no placement policy was given. The caller frees the list.
+ */
+static int node_cpus(struct membash *m, int node, const int *order,
+		     int norder, int **cpus)
+{
+	int count, *list, n = 0;
+
+	count = numa_node_cpus(node, NULL, 0);
+	if (count <= 0){
+		fprintf(stderr, "node %d has no cpus!\n", node);
+		exit(1);
+	}
+
+	list = malloc(count*sizeof(*list));
+	if (list == NULL){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
+	}
+	numa_node_cpus(node, list, count);
+
+	if (order == NULL){
+		*cpus = list;
+		return count;
+	}
+
+	*cpus = malloc(norder*sizeof(**cpus));
+	if (*cpus == NULL){
+		fprintf(stderr,"%s (%d)\n",strerror(errno),
+			errno);
+		exit(errno);
+	}
+	for (int i=0; i<norder; i++)
+		for (int j=0; j<count; j++)
+			if (order[i] == list[j])
+				(*cpus)[n++] = order[i];
+	free(list);
+
+	if (n == 0){
+		fprintf(stderr, "no usable cpus on node %d!\n", node);
+		exit(1);
+	}
+
+	return n;
+}
+
+static void setup_cpu_node(struct membash *m)
+{
+	int *cpus;
+
+	m->ncpus = node_cpus(m, m->cpu_node, m->cpus, m->ncpus, &cpus);
+	free(m->cpus);
+	m->cpus = cpus;
+}
+
+static void print_cpus(struct membash *m)
+{
+	fprintf(m->out, "Placement       : %s",
+		m->placement ? m->placement : "none");
+	if (m->cpu_node >= 0)
+		fprintf(m->out, " on node %d", m->cpu_node);
+	fprintf(m->out, " (cpus ");
+	topology_print_cpus(m->out, m->cpus, (int)m->threads < m->ncpus ?
+			    (int)m->threads : m->ncpus);
+	fprintf(m->out, ")\n");
+
+	if ((int)m->threads > m->ncpus)
+		fprintf(stderr, "warning: %u threads on %d cpus, some cpus "
+			"will run more than one thread\n", m->threads,
+			m->ncpus);
+}
+
+/*
+ * Measure the read and memcpy bandwidth, and the load latency, for
+ * every node with cpus against every node with memory. On a machine
+ * without NUMA this is simply a 1x1 matrix.
+ */
+static int run_numa_matrix(struct membash *m)
+{
+	int cpu_nodes[NUMA_MAX_NODES], mem_nodes[NUMA_MAX_NODES];
+	int ncpu_nodes, nmem_nodes;
+	int *order = m->cpus, norder = m->ncpus;
+	int cpu_node = m->cpu_node;
+	char label[16];
+
+	ncpu_nodes = numa_nodes("has_cpu", cpu_nodes, NUMA_MAX_NODES);
+	nmem_nodes = numa_nodes("has_memory", mem_nodes, NUMA_MAX_NODES);
+	if (ncpu_nodes > NUMA_MAX_NODES)
+		ncpu_nodes = NUMA_MAX_NODES;
+	if (nmem_nodes > NUMA_MAX_NODES)
+		nmem_nodes = NUMA_MAX_NODES;
+
+	double rates[ncpu_nodes][nmem_nodes][3];
+
+	m->quiet = 1;
+	for (int n=0; n<nmem_nodes; n++) {
+		free_buffer(m, m->mem, m->size);
+		m->mem_node = mem_nodes[n];
+		m->mem = alloc_buffer(m, m->size);
+		if (m->mem == NULL){
+			fprintf(stderr,"could not allocate for mem!\n");
+			exit(1);
+		}
+		fill(m);
+
+		for (int c=0; c<ncpu_nodes; c++) {
+			m->ncpus = node_cpus(m, cpu_nodes[c], order, norder,
+					     &m->cpus);
+			m->cpu_node = cpu_nodes[c];
+			run_dumb(m);
+			rates[c][n][0] = m->rate;
+			add_result(m, "NUMA (read)", m->size,
+				   m->done*m->size);
+			run_memcpy(m);
+			rates[c][n][1] = m->rate;
+			add_result(m, "NUMA (memcpy)", m->size,
+				   m->done*m->size);
+			rates[c][n][2] = chase(m, m->size);
+			add_chase_result(m, "NUMA (latency)", m->size);
+			free(m->cpus);
+			m->cpus = order;
+			m->ncpus = norder;
+		}
+	}
+	m->quiet = 0;
+
+	m->cpu_node = cpu_node;
+	m->cpus = order;
+	m->ncpus = norder;
+
+	for (int k=0; k<3; k++) {
+		fprintf(m->out, "%-16s:", k == 0 ? "NUMA read GB/s" :
+			k == 1 ? "NUMA memcpy GB/s" : "NUMA latency ns");
+		for (int n=0; n<nmem_nodes; n++) {
+			snprintf(label, sizeof(label), "mem %d", mem_nodes[n]);
+			fprintf(m->out, " %9s", label);
+		}
+		fprintf(m->out, "\n");
+		for (int c=0; c<ncpu_nodes; c++) {
+			fprintf(m->out, "  cpu node %-4d :", cpu_nodes[c]);
+			for (int n=0; n<nmem_nodes; n++)
+				fprintf(m->out, " %9.2f", k < 2 ?
+					rates[c][n][k] / 1e9 :
+					rates[c][n][k] * 1e9);
+			fprintf(m->out, "\n");
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * --pages all: rerun everything with the buffer on each page size in
+ * turn, skipping the ones this machine can not give us.
+ */
+static int run_pages(struct membash *m)
+{
+	int kind = m->pages_kind;
+	void *mem;
+
+	for (int next=PAGES_4K; next<PAGES_COUNT; next++) {
+		if (next != kind) {
+			m->pages_kind = next;
+			mem = alloc_buffer(m, m->size);
+			m->pages_kind = kind;
+			if (mem == NULL){
+				fprintf(m->out, "Pages           : %s, not "
+					"available (%s)\n", pages_name(next),
+					strerror(errno));
+				continue;
+			}
+
+			free_buffer(m, m->mem, m->size);
+			m->mem = mem;
+			m->pages_kind = kind = next;
+			fill(m);
+			m->dirty = 0;
+			print_pages(m);
+		}
+
+		m->pages_run(m);
+	}
+
+	return 0;
+}
+
+static int run_all(struct membash *m)
+{
+	m->run  = run_dumb;
+	m->run(m);
+
+	m->run  = run_simd;
+	m->run(m);
+
+	m->run  = run_memcpy;
+	m->run(m);
+
+	if ( m->blockcpy ){
+		m->run  = run_blockcpy;
+		m->run(m);
+	}
+
+	m->run  = run_store;
+	m->run(m);
+
+	m->run  = run_store_nt;
+	m->run(m);
+
+	m->run  = run_stosb;
+	m->run(m);
+
+	if ( m->stream ){
+		m->run  = run_stream;
+		m->run(m);
+	}
+
+	if ( m->latency ){
+		m->run  = run_latency;
+		m->run(m);
+	}
+
+	if ( m->mlp ){
+		m->run  = run_mlp;
+		m->run(m);
+	}
+
+	if ( m->wss ){
+		m->run  = run_wss;
+		m->run(m);
+	}
+
+	return 0;
+}
+
+static void setup_results(struct membash *m)
+{
+	results_init(&m->results);
+	results_config(&m->results, "size", 0, "%zu", m->size);
+	results_config(&m->results, "iters", 0, "%zu", m->iters);
+	results_config(&m->results, "blockcpy", 0, "%zu", m->blockcpy);
+	results_config(&m->results, "hash", 0, "%u", m->hash);
+	results_config(&m->results, "permute", 1, "%s", m->permute);
+	results_config(&m->results, "seed", 0, "%zu", m->seed);
+	results_config(&m->results, "mmap", 1, m->mmap ? "%s" : NULL,
+		       m->mmap);
+	results_config(&m->results, "mmap_dst", 1,
+		       m->mmap_dst ? "%s" : NULL, m->mmap_dst);
+	results_config(&m->results, "direction", 1,
+		       m->direction ? "%s" : NULL, m->direction);
+	results_config(&m->results, "threads", 0, "%u", m->threads);
+	results_config(&m->results, "placement", 1,
+		       m->placement ? "%s" : NULL, m->placement);
+	results_config(&m->results, "cpu_node", 0,
+		       m->cpu_node >= 0 ? "%d" : NULL, m->cpu_node);
+	results_config(&m->results, "mem_node", 0,
+		       m->mem_node >= 0 ? "%d" : NULL, m->mem_node);
+	results_config(&m->results, "simd", 1, "%s", m->simd);
+	results_config(&m->results, "copy_engine", 1,
+		       m->copy_engine ? "%s" : NULL, m->copy_engine);
+	results_config(&m->results, "clock", 1, "%s", timer_name());
+	results_config(&m->results, "sweep", 0, "%u", m->sweep);
+	results_config(&m->results, "numa_matrix", 0, "%u", m->numa_matrix);
+	results_config(&m->results, "stream", 0, "%u", m->stream);
+	results_config(&m->results, "stream_dram", 1, "%s", m->stream_dram);
+	results_config(&m->results, "latency", 0, "%u", m->latency);
+	results_config(&m->results, "mlp", 0, "%u", m->mlp);
+	results_config(&m->results, "wss", 0, "%u", m->wss);
+	results_config(&m->results, "warmup", 0, "%zu", m->warmup);
+	results_config(&m->results, "converge", 0, "%g", m->converge);
+	results_config(&m->results, "time_budget", 0, "%g", m->time_budget);
+	results_config(&m->results, "time", 0, "%g", m->duration);
+	results_config(&m->results, "interval", 0, "%g", m->interval);
+	results_config(&m->results, "perf", 1, m->perf ? "%s" : NULL,
+		       m->perf);
+	results_config(&m->results, "cycles", 1, m->cycles ? "%s" : NULL,
+		       freq_name());
+	results_config(&m->results, "pages", 1, m->pages ? "%s" : NULL,
+		       m->pages);
+
+	m->results.nevents = perf_events();
+	for (int i=0; i<perf_events(); i++)
+		m->results.events[i] = perf_event_name(i);
+}
+
+/*
+ * Load the --compare baseline and take over the configuration it was
+ * run with, so the rerun measures the same thing. The clock and the
+ * output options stay as given.
+ */
+static void load_baseline(struct membash *m)
+{
+	const char *v;
+	FILE *f;
+
+	f = fopen(m->compare, "r");
+	if (f == NULL){
+		fprintf(stderr,"%s: %s (%d)\n",m->compare,strerror(errno),
+			errno);
+		exit(errno);
+	}
+	if (results_load_csv(f, &m->baseline)){
+		fprintf(stderr, "%s is not a membash baseline.\n", m->compare);
+		exit(-1);
+	}
+	fclose(f);
+
+#define BASELINE_NUM(key, field)					\
+	if ((v = results_get_config(&m->baseline, key)))		\
+		m->field = strtoull(v, NULL, 0)
+#define BASELINE_STR(key, field)					\
+	m->field = (char *) results_get_config(&m->baseline, key)
+
+	BASELINE_NUM("size", size);
+	BASELINE_NUM("iters", iters);
+	BASELINE_NUM("blockcpy", blockcpy);
+	BASELINE_NUM("hash", hash);
+	BASELINE_NUM("seed", seed);
+	BASELINE_NUM("threads", threads);
+	BASELINE_NUM("sweep", sweep);
+	BASELINE_NUM("numa_matrix", numa_matrix);
+	BASELINE_NUM("stream", stream);
+	BASELINE_NUM("latency", latency);
+	BASELINE_NUM("mlp", mlp);
+	BASELINE_NUM("wss", wss);
+	BASELINE_NUM("warmup", warmup);
+	if ((v = results_get_config(&m->baseline, "converge")))
+		m->converge = strtod(v, NULL);
+	if ((v = results_get_config(&m->baseline, "time_budget")))
+		m->time_budget = strtod(v, NULL);
+	if ((v = results_get_config(&m->baseline, "time")))
+		m->duration = strtod(v, NULL);
+	BASELINE_STR("mmap", mmap);
+	BASELINE_STR("mmap_dst", mmap_dst);
+	BASELINE_STR("direction", direction);
+	if ((v = results_get_config(&m->baseline, "permute")))
+		m->permute = (char *) v;
+	BASELINE_STR("placement", placement);
+	BASELINE_STR("simd", simd);
+	BASELINE_STR("pages", pages);
+	BASELINE_STR("copy_engine", copy_engine);
+
+	m->cpu_node = m->mem_node = -1;
+	BASELINE_NUM("cpu_node", cpu_node);
+	BASELINE_NUM("mem_node", mem_node);
+	if ((v = results_get_config(&m->baseline, "stream_dram")))
+		m->stream_dram = (char *) v;
+
+#undef BASELINE_NUM
+#undef BASELINE_STR
+}
+
+/*
+ * Compare every baseline result against the same measurement from this
+ * run. A slowdown only counts when it is beyond --tolerance and beyond
+ * three standard errors of the difference of the two mean rates, so a
+ * noisy kernel does not fail a rollout on its noise alone. Returns the
+ * number of regressions.
+ */
+static int compare_results(struct membash *m)
+{
+	int regressions = 0;
+
+	fprintf(m->out, "\nCompare with %s\n", m->compare);
+
+	for (size_t i=0; i<m->baseline.count; i++) {
+		const struct result *b = &m->baseline.list[i];
+		const struct result *c = results_find(&m->results, b);
+		double delta, limit, se;
+		const char *status;
+
+		/* The fill is a one shot that mostly times page faults */
+		if (b->rate <= 0 || b->interval_ns ||
+		    !strcmp(b->kernel, "Wrote"))
+			continue;
+
+		fprintf(m->out, "%-16s: ", b->kernel);
+		if (c == NULL || c->rate <= 0) {
+			fprintf(m->out, "missing from this run\n");
+			continue;
+		}
+
+		delta = c->rate / b->rate - 1;
+
+		/*
+		 * A single iteration says nothing about the noise, so
+		 * those rows are held to the plain --tolerance.
+		 */
+		se = 0;
+		if (b->iterations >= 2 && c->iterations >= 2)
+			se = b->rate_cv * b->rate_cv / b->iterations +
+				c->rate_cv * c->rate_cv / c->iterations;
+		limit = fmax(m->tolerance / 100, 3 * sqrt(se));
+
+		if (delta < -limit) {
+			status = "REGRESSION";
+			regressions++;
+		} else if (delta > limit)
+			status = "improved";
+		else
+			status = "ok";
+
+		fprintf(m->out, "%8.2f -> %8.2f MB/s  %+6.1f%% (limit "
+			"%.1f%%%s)  %s", b->rate / 1e6, c->rate / 1e6,
+			delta * 100, limit * 100, se ? "" : ", no noise "
+			"estimate", status);
+		if (b->size != m->size)
+			fprintf(m->out, "  size %zu", b->size);
+		fprintf(m->out, "\n");
+	}
+
+	fprintf(m->out, "%d regression%s\n", regressions,
+		regressions == 1 ? "" : "s");
+
+	return regressions;
+}
+
+static void save_baseline(struct membash *m)
+{
+	FILE *f = fopen(m->save_baseline, "w");
+
+	if (f == NULL){
+		fprintf(stderr,"%s: %s (%d)\n",m->save_baseline,
+			strerror(errno),errno);
+		exit(errno);
+	}
+	results_print_csv(f, &m->results);
+	fclose(f);
+}
+
+static void print_results(struct membash *m)
+{
+	if (!strcmp(m->format, "json"))
+		results_print_json(stdout, &m->results);
+	else if (!strcmp(m->format, "csv"))
+		results_print_csv(stdout, &m->results);
+}
+
+static void cleanup(struct membash *m)
+{
+	results_free(&m->results);
+	results_free(&m->baseline);
+	free(m->cpus);
+
+	if ( m->mmap ){
+		munmap(m->mem, m->size);
+		close(m->mmapfd);
+	}
+	else
+		free_buffer(m, m->mem, m->size);
+
+	if ( m->mmap_dst ){
+		munmap(m->dst_map, m->size);
+		close(m->mmap_dstfd);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct membash cfg;
+	int regressions = 0;
+
+	int args = argconfig_parse(argc, argv, program_desc, command_line_options,
+				   &defaults, &cfg, sizeof(cfg));
+	if (args != 0) {
+		argconfig_print_help(argv[0], program_desc, command_line_options);
+		return 1;
+	}
+
+	if (!strcmp(cfg.format, "text"))
+		cfg.out = stdout;
+	else if (!strcmp(cfg.format, "json") || !strcmp(cfg.format, "csv"))
+		cfg.out = stderr;
+	else {
+		fprintf(stderr, "Unknown output format '%s'.\n", cfg.format);
+		exit(-1);
+	}
+
+	results_init(&cfg.baseline);
+	if (cfg.compare)
+		load_baseline(&cfg);
+	cfg.sample = cfg.percentiles || cfg.compare || cfg.save_baseline;
+
+	cfg.blockcpy_fn = blockcpy_kernel(cfg.blockcpy);
+
+	if (cfg.hash && !cfg.blockcpy){
+		fprintf(stderr, "Can only use --hash when --blockcpy is set.\n");
+		exit(-1);
+	}
+
+	if (!strcmp(cfg.permute, "index"))
+		cfg.permute_kind = PERMUTE_INDEX;
+	else if (!strcmp(cfg.permute, "feistel"))
+		cfg.permute_kind = PERMUTE_FEISTEL;
+	else if (!strcmp(cfg.permute, "both"))
+		cfg.permute_kind = PERMUTE_BOTH;
+	else {
+		fprintf(stderr, "Unknown --permute mode '%s'.\n",
+			cfg.permute);
+		exit(-1);
+	}
+
+	if (cfg.permute_kind != PERMUTE_INDEX && !cfg.hash){
+		fprintf(stderr, "Can only use --permute %s when --hash is "
+			"set.\n", cfg.permute);
+		exit(-1);
+	}
+
+	if (cfg.mlp > MLP_MAX){
+		fprintf(stderr, "--mlp can be at most %d.\n", MLP_MAX);
+		exit(-1);
+	}
+
+	if (cfg.converge < 0 || cfg.time_budget <= 0){
+		fprintf(stderr, "--converge can not be negative and "
+			"--time-budget must be positive.\n");
+		exit(-1);
+	}
+
+	if (cfg.duration < 0 || cfg.interval < 0){
+		fprintf(stderr, "--time and --interval can not be "
+			"negative.\n");
+		exit(-1);
+	}
+
+	if (cfg.threads == 0){
+		fprintf(stderr, "--threads must be at least 1.\n");
+		exit(-1);
+	}
+
+	if (cfg.save_baseline && cfg.iters < CONVERGE_MIN_ITERS &&
+	    !cfg.converge && !cfg.duration){
+		fprintf(stderr, "--save-baseline needs --iters of at least "
+			"%d, --converge or --time.\n", CONVERGE_MIN_ITERS);
+		exit(-1);
+	}
+
+	if ((cfg.mmap || cfg.mmap_dst) &&
+	    (cfg.mem_node >= 0 || cfg.numa_matrix)){
+		fprintf(stderr, "Can not use --mem-node or --numa-matrix "
+			"with --mmap.\n");
+		exit(-1);
+	}
+
+	cfg.direction_kind = (cfg.mmap ? DIRECTION_SRC_IOMEM : 0) |
+		(cfg.mmap_dst ? DIRECTION_DST_IOMEM : 0);
+	if (cfg.direction){
+		for (cfg.direction_kind = 0;
+		     cfg.direction_kind < DIRECTION_COUNT &&
+			     strcmp(cfg.direction,
+				    direction_names[cfg.direction_kind]);
+		     cfg.direction_kind++);
+		if (cfg.direction_kind == DIRECTION_COUNT){
+			fprintf(stderr, "Unknown --direction '%s'.\n",
+				cfg.direction);
+			exit(-1);
+		}
+	}
+	if ((cfg.direction_kind & DIRECTION_SRC_IOMEM) && !cfg.mmap){
+		fprintf(stderr, "--direction %s needs --mmap.\n",
+			cfg.direction);
+		exit(-1);
+	}
+	if (cfg.direction_kind & DIRECTION_DST_IOMEM && !cfg.mmap_dst &&
+	    (cfg.direction_kind & DIRECTION_SRC_IOMEM || !cfg.mmap)){
+		fprintf(stderr, "--direction %s needs --mmap-dst.\n",
+			cfg.direction);
+		exit(-1);
+	}
+
+	cfg.pages_kind = PAGES_DEFAULT;
+	if (cfg.pages && !strcmp(cfg.pages, "all")){
+		if (cfg.mmap || cfg.mmap_dst){
+			fprintf(stderr, "Can not use --pages all with "
+				"--mmap.\n");
+			exit(-1);
+		}
+		cfg.pages_kind = PAGES_4K;
+	}
+	else if (cfg.pages){
+		cfg.pages_kind = pages_parse(cfg.pages);
+		if (cfg.pages_kind <= PAGES_DEFAULT){
+			fprintf(stderr, "Unknown page size '%s'.\n",
+				cfg.pages);
+			exit(-1);
+		}
+	}
+
+	if (timer_init(cfg.clock)){
+		fprintf(stderr, "Clock '%s' is not available.\n",
+			cfg.clock);
+		exit(-1);
+	}
+	if (cfg.verbose) {
+		fprintf(cfg.out, "Clock           : %s", timer_name());
+		if (timer_tsc_ghz())
+			fprintf(cfg.out, " (%.3f GHz)", timer_tsc_ghz());
+		fprintf(cfg.out, ", %lluns overhead\n",
+			(unsigned long long) timer_overhead());
+	}
+
+	if (cfg.perf && perf_init(cfg.perf, stderr)){
+		fprintf(stderr, "Unknown perf events '%s'.\n", cfg.perf);
+		exit(-1);
+	}
+
+	if (cfg.cycles) {
+		freq_init();
+		fprintf(cfg.out, "Cycles          : %s\n", freq_name());
+	}
+
+	int isa = simd_parse(cfg.simd);
+	if (isa < 0 || !simd_supported(isa)){
+		fprintf(stderr, "SIMD variant '%s' is not available.\n",
+			cfg.simd);
+		exit(-1);
+	}
+	cfg.copy = simd_get_copy(COPY_GLIBC);
+	if (cfg.copy_engine && !strcmp(cfg.copy_engine, "all"))
+		cfg.copy_all = 1;
+	else if (cfg.copy_engine){
+		int engine = simd_copy_parse(cfg.copy_engine);
+
+		cfg.copy = engine < 0 ? NULL : simd_get_copy(engine);
+		if (cfg.copy == NULL){
+			fprintf(stderr, "Copy engine '%s' is not "
+				"available.\n", cfg.copy_engine);
+			exit(-1);
+		}
+	}
+
+	cfg.simd = (char *) simd_name(isa);
+	cfg.simd_isa = isa;
+	cfg.simd_sum = simd_get_sum(isa);
+
+	if (cfg.placement)
+		setup_placement(&cfg);
+	if (cfg.cpu_node >= 0)
+		setup_cpu_node(&cfg);
+	if (cfg.cpus)
+		print_cpus(&cfg);
+	if (cfg.mem_node >= 0)
+		fprintf(cfg.out, "Memory node     : %d\n", cfg.mem_node);
+
+	if (cfg.seed==0)
+		cfg.seed = time(NULL);
+	srand(cfg.seed);
+
+	setup_results(&cfg);
+	setup(&cfg);
+
+#ifndef __powerpc64__
+	if ( cfg.fence )
+		asm volatile("mfence" ::: "memory");
+#endif
+	if ( cfg.numa_matrix )
+		cfg.run  = run_numa_matrix;
+	else if ( cfg.sweep )
+		cfg.run  = run_sweep;
+	else
+		cfg.run  = run_all;
+	if (cfg.pages && !strcmp(cfg.pages, "all")){
+		cfg.pages_run = cfg.run;
+		cfg.run  = run_pages;
+	}
+	cfg.run(&cfg);
+
+	print_results(&cfg);
+	if (cfg.save_baseline)
+		save_baseline(&cfg);
+	if (cfg.compare)
+		regressions = compare_results(&cfg);
+	cleanup(&cfg);
+	return regressions ? 2 : 0;
 }
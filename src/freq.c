@@ -0,0 +1,173 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Effective core frequency measurement
+//
+////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include "freq.h"
+#include "perf.h"
+#include "timer.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MSR_IA32_APERF 0xe8
+#define FREQ_LOOP_ADDS (1 << 22)
+
+enum {
+    FREQ_PERF,
+    FREQ_APERF,
+    FREQ_LOOP,
+};
+
+static int source = FREQ_LOOP;
+
+static int msr_open(int cpu)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), "/dev/cpu/%d/msr", cpu);
+    return open(path, O_RDONLY);
+}
+
+static int msr_read(int fd, unsigned reg, uint64_t *value)
+{
+    return pread(fd, value, sizeof(*value), reg) == sizeof(*value) ? 0 : -1;
+}
+
+/*
+ * Pick the best source this machine allows: a perf cycle counter, else
+ * the APERF MSR (which needs root and the msr driver), else timing a
+ * dependent add loop, which only ever sees the frequency the core runs
+ * at just after the kernel.
+ */
+int freq_init(void)
+{
+    uint64_t value;
+    int fd;
+
+    fd = perf_open_cycles();
+    if (fd >= 0) {
+        close(fd);
+        source = FREQ_PERF;
+        return 0;
+    }
+
+    fd = msr_open(sched_getcpu());
+    if (fd >= 0) {
+        if (!msr_read(fd, MSR_IA32_APERF, &value))
+            source = FREQ_APERF;
+        close(fd);
+        if (source == FREQ_APERF)
+            return 0;
+    }
+
+    source = FREQ_LOOP;
+    return 0;
+}
+
+const char *freq_name(void)
+{
+    switch (source) {
+    case FREQ_PERF:  return "perf cycles";
+    case FREQ_APERF: return "aperf";
+    default:         return "add loop";
+    }
+}
+
+void freq_start(struct freq_sample *s)
+{
+    s->fd = -1;
+
+    if (source == FREQ_PERF) {
+        s->fd = perf_open_cycles();
+        if (s->fd >= 0 && perf_read_counter(s->fd, &s->start)) {
+            close(s->fd);
+            s->fd = -1;
+        }
+    } else if (source == FREQ_APERF) {
+        s->cpu = sched_getcpu();
+        s->fd = msr_open(s->cpu);
+        if (s->fd >= 0 && msr_read(s->fd, MSR_IA32_APERF, &s->start)) {
+            close(s->fd);
+            s->fd = -1;
+        }
+    }
+}
+
+/*
+ * Returns the cycles over the ns the thread just ran for, or -1 if
+ * they could not be measured. APERF counts for the cpu rather than the
+ * thread so it is only trusted if the thread did not migrate.
+ */
+double freq_stop(struct freq_sample *s, uint64_t ns)
+{
+    uint64_t end;
+    double cycles = -1;
+
+    if (source == FREQ_LOOP)
+        return freq_loop_ghz() * ns;
+
+    if (s->fd < 0)
+        return -1;
+
+    if (source == FREQ_PERF && !perf_read_counter(s->fd, &end))
+        cycles = end - s->start;
+    else if (source == FREQ_APERF && sched_getcpu() == s->cpu &&
+             !msr_read(s->fd, MSR_IA32_APERF, &end))
+        cycles = end - s->start;
+
+    close(s->fd);
+    s->fd = -1;
+    return cycles;
+}
+
+#define FREQ_ADD() do { x += one; __asm__ volatile("" : "+r" (x)); } while (0)
+
+/*
+ * Time a chain of dependent adds, each of which takes one cycle on
+ * any core worth benchmarking. The empty asm keeps the compiler from
+ * folding the chain and the unrolling hides the loop branch. The
+ * addend is hidden in a register too: some cores retire chains of
+ * immediate adds faster than one a cycle.
+ */
+double freq_loop_ghz(void)
+{
+    uint64_t start, end, x = 0, one = 1;
+
+    __asm__ volatile("" : "+r" (one));
+    start = timer_start();
+    for (unsigned i = 0; i < FREQ_LOOP_ADDS; i += 4) {
+        FREQ_ADD();
+        FREQ_ADD();
+        FREQ_ADD();
+        FREQ_ADD();
+    }
+    end = timer_stop();
+
+    return end > start ? (double) FREQ_LOOP_ADDS / (end - start) : -1;
+}
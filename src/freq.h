@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Effective core frequency measurement
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_FREQ_H__
+#define __MEMBASH_FREQ_H__
+
+#include <stdint.h>
+
+/*
+ * The cycles one thread spent between freq_start() and freq_stop().
+ * Start and stop must be called from the same thread.
+ */
+struct freq_sample {
+    int fd;
+    int cpu;
+    uint64_t start;
+};
+
+int freq_init(void);
+const char *freq_name(void);
+
+void freq_start(struct freq_sample *s);
+double freq_stop(struct freq_sample *s, uint64_t ns);
+
+double freq_loop_ghz(void);
+
+#endif
@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     NUMA node discovery and memory binding
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#define _GNU_SOURCE
+#include "numa.h"
+#include "topology.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#define SYSFS_NODE "/sys/devices/system/node"
+
+/*
+ * From linux/mempolicy.h, we call the syscalls directly rather than
+ * pulling in libnuma.
+ */
+#define MPOL_BIND       2
+#define MPOL_MF_STRICT  (1 << 0)
+#define MPOL_MF_MOVE    (1 << 1)
+
+static int read_list(const char *path, int *list, int max)
+{
+    char line[4096];
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL)
+        return -1;
+    if (fgets(line, sizeof(line), f) == NULL) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    return topology_parse_cpulist(line, list, max);
+}
+
+/*
+ * Kernels without NUMA support have no node directory. We then report
+ * a single node 0 with every cpu we are allowed on and nothing to bind
+ * to, so callers still work.
+ */
+static int numa_missing(int node)
+{
+    return node == 0 && access(SYSFS_NODE, F_OK) != 0;
+}
+
+static int allowed_cpus(int *cpus, int max_cpus)
+{
+    cpu_set_t allowed;
+    int n = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed))
+        return -1;
+
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+        if (!CPU_ISSET(i, &allowed))
+            continue;
+        if (n < max_cpus)
+            cpus[n] = i;
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ * List the nodes in a given sysfs state, eg. "has_cpu" or
+ * "has_memory".
+ */
+int numa_nodes(const char *state, int *nodes, int max_nodes)
+{
+    char path[256];
+    int ret;
+
+    snprintf(path, sizeof(path), SYSFS_NODE "/%s", state);
+    ret = read_list(path, nodes, max_nodes);
+    if (ret <= 0) {
+        if (max_nodes > 0)
+            nodes[0] = 0;
+        return 1;
+    }
+
+    return ret;
+}
+
+int numa_node_cpus(int node, int *cpus, int max_cpus)
+{
+    char path[256];
+
+    if (numa_missing(node))
+        return allowed_cpus(cpus, max_cpus);
+
+    snprintf(path, sizeof(path), SYSFS_NODE "/node%d/cpulist", node);
+    return read_list(path, cpus, max_cpus);
+}
+
+/*
+ * Bind the pages in [addr, addr+len) to a node, moving any that have
+ * already been faulted in elsewhere. addr must be page aligned.
+ */
+int numa_bind(void *addr, size_t len, int node)
+{
+    unsigned long mask[NUMA_MAX_NODES / (sizeof(unsigned long) * CHAR_BIT)] = {0};
+    const size_t bits = sizeof(unsigned long) * CHAR_BIT;
+
+    if (node < 0 || node >= NUMA_MAX_NODES) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (numa_missing(node))
+        return 0;
+
+    mask[node / bits] |= 1UL << (node % bits);
+
+    return syscall(SYS_mbind, addr, len, MPOL_BIND, mask,
+                   NUMA_MAX_NODES + 1, MPOL_MF_STRICT | MPOL_MF_MOVE);
+}
@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     NUMA node discovery and memory binding
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_NUMA_H__
+#define __MEMBASH_NUMA_H__
+
+#include <stddef.h>
+
+#define NUMA_MAX_NODES 1024
+
+int numa_nodes(const char *state, int *nodes, int max_nodes);
+
+int numa_node_cpus(int node, int *cpus, int max_cpus);
+
+int numa_bind(void *addr, size_t len, int node);
+
+#endif
@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Page size selection for the test buffers
+//
+////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include "pages.h"
+
+#include <sys/mman.h>
+#include <sys/vfs.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#define HUGETLBFS_MAGIC 0x958458f6
+#define THP_SIZE        (2UL << 20)
+
+static const struct {
+    const char *name;
+    size_t page_size;
+} kinds[PAGES_COUNT] = {
+    [PAGES_DEFAULT] = {"default", 0},
+    [PAGES_4K]      = {"4k",      4096},
+    [PAGES_THP]     = {"thp",     THP_SIZE},
+    [PAGES_2M]      = {"2m",      2UL << 20},
+    [PAGES_1G]      = {"1g",      1UL << 30},
+};
+
+int pages_parse(const char *name)
+{
+    for (int i = 0; i < PAGES_COUNT; i++)
+        if (!strcmp(name, kinds[i].name))
+            return i;
+
+    return -1;
+}
+
+const char *pages_name(int kind)
+{
+    return kinds[kind].name;
+}
+
+static size_t round_up(size_t size, size_t align)
+{
+    return (size + align - 1) & ~(align - 1);
+}
+
+/*
+ * Map size bytes aligned to a THP so every whole 2MiB of the buffer
+ * can be a huge page, then ask for them. Whether we get them is up to
+ * khugepaged and fragmentation, see pages_query().
+ */
+static void *thp_alloc(size_t size)
+{
+    size_t len = round_up(size, THP_SIZE) + THP_SIZE;
+    char *buf, *aligned;
+
+    buf = mmap(NULL, len, PROT_WRITE | PROT_READ,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED)
+        return NULL;
+
+    aligned = (char *) round_up((uintptr_t) buf, THP_SIZE);
+    if (aligned > buf)
+        munmap(buf, aligned - buf);
+    len -= aligned - buf;
+    if (len > round_up(size, THP_SIZE))
+        munmap(aligned + round_up(size, THP_SIZE),
+               len - round_up(size, THP_SIZE));
+
+    if (madvise(aligned, size, MADV_HUGEPAGE)) {
+        munmap(aligned, round_up(size, THP_SIZE));
+        return NULL;
+    }
+
+    return aligned;
+}
+
+/*
+ * Allocate an untouched anonymous buffer of the given kind. Returns
+ * NULL with errno set if the pages are not available, eg. ENOMEM for
+ * hugetlb sizes with no pages reserved in /proc/sys/vm/nr_hugepages.
+ */
+void *pages_alloc(size_t size, int kind)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *buf;
+
+    switch (kind) {
+    case PAGES_THP:
+        return thp_alloc(size);
+    case PAGES_2M:
+    case PAGES_1G:
+        flags |= MAP_HUGETLB |
+            (__builtin_ctzl(kinds[kind].page_size) << MAP_HUGE_SHIFT);
+        size = round_up(size, kinds[kind].page_size);
+        break;
+    case PAGES_4K:
+        break;
+    default:
+        return malloc(size);
+    }
+
+    buf = mmap(NULL, size, PROT_WRITE | PROT_READ, flags, -1, 0);
+    if (buf == MAP_FAILED)
+        return NULL;
+
+    if (kind == PAGES_4K)
+        madvise(buf, size, MADV_NOHUGEPAGE);
+
+    return buf;
+}
+
+void pages_free(void *buf, size_t size, int kind)
+{
+    if (kind == PAGES_DEFAULT) {
+        free(buf);
+        return;
+    }
+
+    if (kind != PAGES_4K)
+        size = round_up(size, kinds[kind].page_size);
+    munmap(buf, size);
+}
+
+/*
+ * Check an mmap'd file gives the pages asked for. Huge pages for a
+ * file come from where it lives, so 2m and 1g need it to be on a
+ * hugetlbfs mount of that page size. Returns -1 with errno set if not.
+ */
+int pages_map_file(void *buf, size_t size, int fd, int kind)
+{
+    struct statfs fs;
+
+    switch (kind) {
+    case PAGES_THP:
+        return madvise(buf, size, MADV_HUGEPAGE);
+    case PAGES_4K:
+        return madvise(buf, size, MADV_NOHUGEPAGE);
+    case PAGES_2M:
+    case PAGES_1G:
+        if (fstatfs(fd, &fs))
+            return -1;
+        if (fs.f_type != HUGETLBFS_MAGIC ||
+            (size_t) fs.f_bsize != kinds[kind].page_size) {
+            errno = EINVAL;
+            return -1;
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Find out what the kernel actually backed [buf, buf+size) with, from
+ * /proc/self/smaps: the page size of the mappings and how many bytes
+ * of them are transparent huge pages. Only meaningful once the buffer
+ * has been touched.
+ */
+int pages_query(const void *buf, size_t size, size_t *page_size,
+                size_t *huge_bytes)
+{
+    uintptr_t start = (uintptr_t) buf, end = start + size;
+    unsigned long lo, hi, kb;
+    int inside = 0, found = 0;
+    char line[512];
+    FILE *f;
+
+    *page_size = 0;
+    *huge_bytes = 0;
+
+    f = fopen("/proc/self/smaps", "r");
+    if (f == NULL)
+        return -1;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            inside = lo < end && hi > start;
+            continue;
+        }
+        if (!inside)
+            continue;
+
+        if (sscanf(line, "KernelPageSize: %lu kB", &kb) == 1) {
+            if (kb * 1024 > *page_size)
+                *page_size = kb * 1024;
+            found = 1;
+        } else if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+                   sscanf(line, "ShmemPmdMapped: %lu kB", &kb) == 1 ||
+                   sscanf(line, "FilePmdMapped: %lu kB", &kb) == 1) {
+            *huge_bytes += kb * 1024;
+        }
+    }
+    fclose(f);
+
+    if (*huge_bytes > size)
+        *huge_bytes = size;
+
+    return found ? 0 : -1;
+}
@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Page size selection for the test buffers
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_PAGES_H__
+#define __MEMBASH_PAGES_H__
+
+#include <stddef.h>
+
+enum pages_kind {
+    PAGES_DEFAULT,
+    PAGES_4K,
+    PAGES_THP,
+    PAGES_2M,
+    PAGES_1G,
+    PAGES_COUNT,
+};
+
+int pages_parse(const char *name);
+const char *pages_name(int kind);
+
+void *pages_alloc(size_t size, int kind);
+void pages_free(void *buf, size_t size, int kind);
+int pages_map_file(void *buf, size_t size, int fd, int kind);
+
+int pages_query(const void *buf, size_t size, size_t *page_size,
+                size_t *huge_bytes);
+
+#endif
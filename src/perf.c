@@ -0,0 +1,249 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Hardware performance counters via perf_event_open
+//
+////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include "perf.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define PERF_DEFAULT "cycles,instructions,llc-misses,dtlb-misses"
+
+#define HW_CACHE(cache, op, result) \
+    (PERF_COUNT_HW_CACHE_##cache | (PERF_COUNT_HW_CACHE_OP_##op << 8) | \
+     (PERF_COUNT_HW_CACHE_RESULT_##result << 16))
+
+static const struct perf_known {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} known[] = {
+    {"cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"l1d-misses",   PERF_TYPE_HW_CACHE, HW_CACHE(L1D, READ, MISS)},
+    {"llc-loads",    PERF_TYPE_HW_CACHE, HW_CACHE(LL, READ, ACCESS)},
+    {"llc-misses",   PERF_TYPE_HW_CACHE, HW_CACHE(LL, READ, MISS)},
+    {"dtlb-loads",   PERF_TYPE_HW_CACHE, HW_CACHE(DTLB, READ, ACCESS)},
+    {"dtlb-misses",  PERF_TYPE_HW_CACHE, HW_CACHE(DTLB, READ, MISS)},
+    {"task-clock",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults",  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {0}
+};
+
+static struct perf_event {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} events[PERF_MAX_EVENTS];
+static int nevents;
+static char *names;
+
+static int open_event(const struct perf_event *e, int group)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = e->type;
+    attr.config = e->config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+        PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static int parse_event(const char *name, struct perf_event *e)
+{
+    const struct perf_known *k;
+    char *end;
+
+    e->name = name;
+    if (name[0] == 'r' && name[1]) {
+        e->type = PERF_TYPE_RAW;
+        e->config = strtoull(name + 1, &end, 16);
+        return *end ? -1 : 0;
+    }
+
+    for (k = known; k->name; k++) {
+        if (!strcmp(name, k->name)) {
+            e->type = k->type;
+            e->config = k->config;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Parse a comma separated list of event names, raw rNNNN (hex) event
+ * codes or "default", and drop (with a warning) the ones this machine
+ * will not count, eg. hardware events under most hypervisors. Returns
+ * -1 if the list does not parse.
+ */
+int perf_init(const char *list, FILE *warn)
+{
+    char *name, *save;
+
+    if (!strcmp(list, "default"))
+        list = PERF_DEFAULT;
+
+    names = strdup(list);
+    if (names == NULL)
+        return -1;
+
+    for (name = strtok_r(names, ",", &save); name;
+         name = strtok_r(NULL, ",", &save)) {
+        struct perf_event *e = &events[nevents];
+        int fd;
+
+        if (nevents == PERF_MAX_EVENTS || parse_event(name, e)) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        fd = open_event(e, -1);
+        if (fd < 0) {
+            fprintf(warn, "perf event %s is not available: %s\n",
+                    name, strerror(errno));
+            continue;
+        }
+        close(fd);
+        nevents++;
+    }
+
+    return 0;
+}
+
+int perf_events(void)
+{
+    return nevents;
+}
+
+const char *perf_event_name(int i)
+{
+    return events[i].name;
+}
+
+/*
+ * Open the counters for the calling thread, stopped. Returns -1 if any
+ * of them would not open, leaving the group empty.
+ */
+int perf_open(struct perf_group *g)
+{
+    g->count = 0;
+
+    for (int i = 0; i < nevents; i++) {
+        g->fds[i] = open_event(&events[i], i ? g->fds[0] : -1);
+        if (g->fds[i] < 0) {
+            perf_close(g);
+            return -1;
+        }
+        g->count++;
+    }
+
+    return 0;
+}
+
+void perf_start(struct perf_group *g)
+{
+    if (!g->count)
+        return;
+
+    ioctl(g->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/*
+ * Stop the group and read it into counts, scaled up for any time the
+ * kernel had it multiplexed out. Counts are -1 when an event did not
+ * get counted at all.
+ */
+void perf_stop(struct perf_group *g, double *counts)
+{
+    uint64_t buf[3 + PERF_MAX_EVENTS];
+    double scale = 0;
+
+    for (int i = 0; i < nevents; i++)
+        counts[i] = -1;
+
+    if (!g->count)
+        return;
+
+    ioctl(g->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read(g->fds[0], buf, sizeof(buf)) < (ssize_t) (3 * sizeof(*buf)))
+        return;
+
+    if (buf[2])
+        scale = (double) buf[1] / buf[2];
+    if (scale == 0)
+        return;
+
+    for (uint64_t i = 0; i < buf[0] && i < (uint64_t) nevents; i++)
+        counts[i] = buf[3 + i] * scale;
+}
+
+void perf_close(struct perf_group *g)
+{
+    for (int i = 0; i < g->count; i++)
+        close(g->fds[i]);
+    g->count = 0;
+}
+
+/*
+ * A lone, free running cycle counter for the calling thread, for the
+ * cycle normalised rates. Returns -1 if there is no cycle counter.
+ */
+int perf_open_cycles(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int perf_read_counter(int fd, uint64_t *value)
+{
+    return read(fd, value, sizeof(*value)) == sizeof(*value) ? 0 : -1;
+}
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Hardware performance counters via perf_event_open
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_PERF_H__
+#define __MEMBASH_PERF_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define PERF_MAX_EVENTS 8
+
+/*
+ * One thread's counters, opened as a single group so they all count
+ * over exactly the same instructions.
+ */
+struct perf_group {
+    int fds[PERF_MAX_EVENTS];
+    int count;
+};
+
+int perf_init(const char *events, FILE *warn);
+int perf_events(void);
+const char *perf_event_name(int i);
+
+int perf_open(struct perf_group *g);
+void perf_start(struct perf_group *g);
+void perf_stop(struct perf_group *g, double *counts);
+void perf_close(struct perf_group *g);
+
+int perf_open_cycles(void);
+int perf_read_counter(int fd, uint64_t *value);
+
+#endif
@@ -28,9 +28,16 @@
 #include "report.h"
 #include "suffix.h"
 
-static double timeval_to_secs(struct timeval *t)
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ * Timestamps are in ns. The end may have had the clock overhead taken
+ * off it, so an interval shorter than that comes out as zero.
+ */
+static double elapsed_secs(uint64_t start_ns, uint64_t end_ns)
 {
-    return  t->tv_sec + t->tv_usec / 1e6;
+    return end_ns > start_ns ? (end_ns - start_ns) / 1e9 : 0;
 }
 
 void report_transfer_rate_elapsed(FILE *outf, double elapsed_time,
@@ -51,11 +58,10 @@ void report_transfer_rate_elapsed(FILE *outf, double elapsed_time,
             t_suffix);
 }
 
-void report_transfer_rate(FILE *outf, struct timeval *start_time,
-                          struct timeval *end_time, size_t bytes)
+void report_transfer_rate(FILE *outf, uint64_t start_ns,
+                          uint64_t end_ns, size_t bytes)
 {
-    double elapsed_time = timeval_to_secs(end_time) -
-        timeval_to_secs(start_time);
+    double elapsed_time = elapsed_secs(start_ns, end_ns);
     report_transfer_rate_elapsed(outf, elapsed_time, bytes);
 }
 
@@ -77,59 +83,183 @@ void report_transfer_bin_rate_elapsed(FILE *outf, double elapsed_time,
             throughput, t_suffix);
 }
 
-void report_transfer_bin_rate(FILE *outf, struct timeval *start_time,
-                              struct timeval *end_time, size_t bytes)
+void report_transfer_bin_rate(FILE *outf, uint64_t start_ns,
+                              uint64_t end_ns, size_t bytes)
 {
-    double elapsed_time = timeval_to_secs(end_time) -
-        timeval_to_secs(start_time);
+    double elapsed_time = elapsed_secs(start_ns, end_ns);
     report_transfer_bin_rate_elapsed(outf, elapsed_time, bytes);
 }
 
-void report_latency(FILE *outf, FILE *log, struct timeval *start_time,
-		    struct timeval *latencies, size_t count)
+void report_load_latency_elapsed(FILE *outf, double elapsed_time,
+                                 size_t loads)
+{
+    double loads_d = loads;
+    double latency = elapsed_time / loads;
+
+    const char *l_suffix = suffix_si_get(&loads_d);
+    const char *p_suffix = suffix_si_get(&latency);
+
+    const char *e_suffix = " ";
+    if (elapsed_time < 1)
+        e_suffix = suffix_si_get(&elapsed_time);
+
+    fprintf(outf, "%6.2f%s loads in %-6.1f%ss   %6.2f%ss/load",
+            loads_d, l_suffix, elapsed_time, e_suffix, latency,
+            p_suffix);
+}
+
+void report_load_latency(FILE *outf, uint64_t start_ns,
+                         uint64_t end_ns, size_t loads)
 {
-    const char *min_suffix = " ", *max_suffix = " ",
-        *avg_suffix = " ";
-    double elapsed_time, min_time, max_time, avg_time;
-    size_t min_pos = 0, max_pos = 0;
+    double elapsed_time = elapsed_secs(start_ns, end_ns);
+    report_load_latency_elapsed(outf, elapsed_time, loads);
+}
+
+static void print_rate(FILE *outf, double rate)
+{
+    const char *suffix = suffix_si_get(&rate);
+
+    fprintf(outf, "%6.2f%sB/s", rate, suffix);
+}
 
-    elapsed_time = timeval_to_secs(&latencies[0]) -
-        timeval_to_secs(start_time);
-    if (log)
-        fprintf(log,"%4d\t%f\n", 0, elapsed_time);
+static void print_time(FILE *outf, double secs)
+{
+    const char *suffix = " ";
 
-    min_time = max_time = avg_time = elapsed_time;
+    if (secs < 1)
+        suffix = suffix_si_get(&secs);
+    fprintf(outf, "%6.2f%ss", secs, suffix);
+}
 
-    for (unsigned i=1 ; i<count ; i++) {
+static const struct {
+    const char *name;
+    double fraction;
+} percentiles[] = {
+    {"p50",   0.5},
+    {"p90",   0.9},
+    {"p99",   0.99},
+    {"p99.9", 0.999},
+};
 
-        elapsed_time = timeval_to_secs(&latencies[i]) -
-	    timeval_to_secs(&latencies[i-1]);
-	if (log)
-	    fprintf(log,"%4d\t%f\n", i, elapsed_time);
+#define PERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
 
-	if (elapsed_time < min_time) {
-	    min_time = elapsed_time;
-	    min_pos  = i;
-	} else if (elapsed_time > max_time) {
-	    max_time = elapsed_time;
-	    max_pos  = i;
-	}
+/*
+ * s holds the ns taken to move bytes. Percentiles are of the time
+ * taken, so p99 is the rate that 99% of the samples managed to beat
+ * and the list runs from the best sample (max) to the worst (min).
+ */
+void report_rate_percentiles(FILE *outf, const struct stats *s,
+                             double bytes)
+{
+    if (s->count == 0)
+        return;
 
-	avg_time += elapsed_time;
+    fprintf(outf, "max ");
+    print_rate(outf, s->min ? bytes * 1e9 / s->min : 0);
+    for (unsigned i = 0; i < PERCENTILES; i++) {
+        uint64_t ns = stats_percentile(s, percentiles[i].fraction);
+        fprintf(outf, "  %s ", percentiles[i].name);
+        print_rate(outf, ns ? bytes * 1e9 / ns : 0);
+    }
+    fprintf(outf, "  min ");
+    print_rate(outf, s->max ? bytes * 1e9 / s->max : 0);
+}
 
+#define HISTOGRAM_STEPS  4
+#define HISTOGRAM_WIDTH  40
+
+/*
+ * Print a histogram of the rates (s again holding the ns to move
+ * bytes) with HISTOGRAM_STEPS buckets per doubling, covering only the
+ * range that has any samples in it.
+ */
+void report_rate_histogram(FILE *outf, const char *indent,
+                           const struct stats *s, double bytes)
+{
+    int lo = INT32_MAX, hi = INT32_MIN, nbuckets;
+    uint64_t *buckets, most = 0;
+
+    for (int i = 1; i < STATS_BUCKETS; i++) {
+        if (!s->buckets[i])
+            continue;
+        int b = floor(log2(bytes * 1e9 / stats_bucket_value(i)) *
+                      HISTOGRAM_STEPS);
+        if (b < lo)
+            lo = b;
+        if (b > hi)
+            hi = b;
+    }
+    if (lo > hi)
+        return;
+
+    nbuckets = hi - lo + 1;
+    buckets = calloc(nbuckets, sizeof(*buckets));
+    if (buckets == NULL)
+        return;
+
+    for (int i = 1; i < STATS_BUCKETS; i++) {
+        if (!s->buckets[i])
+            continue;
+        int b = floor(log2(bytes * 1e9 / stats_bucket_value(i)) *
+                      HISTOGRAM_STEPS) - lo;
+        buckets[b] += s->buckets[i];
+        if (buckets[b] > most)
+            most = buckets[b];
+    }
+
+    for (int b = 0; b < nbuckets; b++) {
+        int bar = (buckets[b] * HISTOGRAM_WIDTH + most - 1) / most;
+
+        fprintf(outf, "%s", indent);
+        print_rate(outf, exp2((double) (b + lo) / HISTOGRAM_STEPS));
+        fprintf(outf, " - ");
+        print_rate(outf, exp2((double) (b + lo + 1) / HISTOGRAM_STEPS));
+        fprintf(outf, " %8llu", (unsigned long long) buckets[b]);
+        if (bar)
+            fputc(' ', outf);
+        for (int i = 0; i < bar; i++)
+            fputc('#', outf);
+        fprintf(outf, "\n");
+    }
+
+    free(buckets);
+}
+
+/*
+ * Summarise latency samples recorded in units of unit seconds. The
+ * samples live in a struct stats, so the caller keeps constant memory
+ * however many it records.
+ */
+void report_latency(FILE *outf, const struct stats *s, double unit)
+{
+    if (s->count == 0)
+        return;
+
+    fprintf(outf, "min ");
+    print_time(outf, s->min * unit);
+    for (unsigned i = 0; i < PERCENTILES; i++) {
+        fprintf(outf, "  %s ", percentiles[i].name);
+        print_time(outf, stats_percentile(s, percentiles[i].fraction) * unit);
+    }
+    fprintf(outf, "  max ");
+    print_time(outf, s->max * unit);
+    fprintf(outf, "  avg ");
+    print_time(outf, s->mean * unit);
+    fprintf(outf, "  sd ");
+    print_time(outf, stats_stddev(s) * unit);
+}
+
+/*
+ * Normalise an event count over a transfer to per byte and per 64
+ * byte cache line. A negative count is one that was not counted.
+ */
+void report_event_rate(FILE *outf, double count, double bytes)
+{
+    if (count < 0) {
+        fprintf(outf, "not counted");
+        return;
     }
 
-    if (min_time < 1)
-        min_suffix = suffix_si_get(&min_time);
-    fprintf(outf, "min (%zd) = %-6.1f%ss : ",
-            min_pos, min_time, min_suffix);
-    if (max_time < 1)
-        max_suffix = suffix_si_get(&max_time);
-    fprintf(outf, "max (%zd) = %-6.1f%ss : ",
-            max_pos, max_time, max_suffix);
-    avg_time /= count;
-    if (avg_time < 1)
-        avg_suffix = suffix_si_get(&avg_time);
-    fprintf(outf, "avg (%zd) = %-6.1f%ss",
-            count, avg_time, avg_suffix);
+    fprintf(outf, "%14.0f  %10.4f/byte  %10.3f/line", count,
+            count / bytes, count * 64 / bytes);
 }
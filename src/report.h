@@ -29,20 +29,33 @@
 #define __ARGCONFIG_REPORT_H__
 
 #include <stdio.h>
-#include <sys/time.h>
+#include <stdint.h>
+
+#include "stats.h"
 
 void report_transfer_rate_elapsed(FILE *outf, double elapsed_time,
                                   size_t bytes);
 
-void report_transfer_rate(FILE *outf, struct timeval *start_time,
-                          struct timeval *end_time, size_t bytes);
+void report_transfer_rate(FILE *outf, uint64_t start_ns,
+                          uint64_t end_ns, size_t bytes);
 
 void report_transfer_bin_rate_elapsed(FILE *outf, double elapsed_time,
                                       size_t bytes);
-void report_transfer_bin_rate(FILE *outf, struct timeval *start_time,
-                              struct timeval *end_time, size_t bytes);
+void report_transfer_bin_rate(FILE *outf, uint64_t start_ns,
+                              uint64_t end_ns, size_t bytes);
+
+void report_load_latency_elapsed(FILE *outf, double elapsed_time,
+                                 size_t loads);
+void report_load_latency(FILE *outf, uint64_t start_ns,
+                         uint64_t end_ns, size_t loads);
+
+void report_rate_percentiles(FILE *outf, const struct stats *s,
+                             double bytes);
+void report_rate_histogram(FILE *outf, const char *indent,
+                           const struct stats *s, double bytes);
+
+void report_latency(FILE *outf, const struct stats *s, double unit);
 
-void report_latency(FILE *outf, FILE *log, struct timeval *start_time,
-		    struct timeval *latencies, size_t count);
+void report_event_rate(FILE *outf, double count, double bytes);
 
 #endif
@@ -0,0 +1,417 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Collecting results for machine readable output
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#define _GNU_SOURCE
+#include "results.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+
+void results_init(struct results *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+void results_free(struct results *r)
+{
+    for (int i = 0; i < r->nconfig; i++) {
+        free(r->config[i].value);
+        if (r->owns_keys)
+            free((char *) r->config[i].key);
+    }
+    free(r->list);
+    results_init(r);
+}
+
+/*
+ * Record a configuration value to print alongside the results. A NULL
+ * fmt records a null value.
+ */
+void results_config(struct results *r, const char *key, int quoted,
+                    const char *fmt, ...)
+{
+    va_list ap;
+
+    if (r->nconfig == RESULTS_MAX_CONFIG)
+        return;
+
+    r->config[r->nconfig].key = key;
+    r->config[r->nconfig].quoted = quoted;
+    r->config[r->nconfig].value = NULL;
+    if (fmt) {
+        va_start(ap, fmt);
+        if (vasprintf(&r->config[r->nconfig].value, fmt, ap) < 0)
+            r->config[r->nconfig].value = NULL;
+        va_end(ap);
+    }
+    r->nconfig++;
+}
+
+struct result *results_add(struct results *r, const char *kernel)
+{
+    struct result *res;
+    size_t len;
+
+    if (r->count == r->alloc) {
+        size_t alloc = r->alloc ? r->alloc * 2 : 64;
+        struct result *list = realloc(r->list, alloc * sizeof(*list));
+
+        if (list == NULL) {
+            fprintf(stderr, "%s (%d)\n", strerror(errno), errno);
+            exit(errno);
+        }
+        r->list = list;
+        r->alloc = alloc;
+    }
+
+    res = &r->list[r->count++];
+    memset(res, 0, sizeof(*res));
+    res->cpu_node = res->mem_node = -1;
+
+    // Drop the padding the text labels carry
+    len = strlen(kernel);
+    while (len && kernel[len-1] == ' ')
+        len--;
+    if (len >= sizeof(res->kernel))
+        len = sizeof(res->kernel) - 1;
+    memcpy(res->kernel, kernel, len);
+
+    return res;
+}
+
+static void print_json_string(FILE *outf, const char *s)
+{
+    fputc('"', outf);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(outf, "\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            fprintf(outf, "\\u%04x", *s);
+        else
+            fputc(*s, outf);
+    }
+    fputc('"', outf);
+}
+
+static void print_json_value(FILE *outf, const char *value, int quoted)
+{
+    if (value == NULL)
+        fprintf(outf, "null");
+    else if (quoted)
+        print_json_string(outf, value);
+    else
+        fprintf(outf, "%s", value);
+}
+
+void results_print_json(FILE *outf, const struct results *r)
+{
+    fprintf(outf, "{\n  \"config\": {");
+    for (int i = 0; i < r->nconfig; i++) {
+        fprintf(outf, "%s\n    ", i ? "," : "");
+        print_json_string(outf, r->config[i].key);
+        fprintf(outf, ": ");
+        print_json_value(outf, r->config[i].value, r->config[i].quoted);
+    }
+    fprintf(outf, "\n  },\n  \"results\": [");
+
+    for (size_t i = 0; i < r->count; i++) {
+        const struct result *res = &r->list[i];
+
+        fprintf(outf, "%s\n    {\"kernel\": ", i ? "," : "");
+        print_json_string(outf, res->kernel);
+        fprintf(outf, ", \"size\": %zu, \"threads\": %u, "
+                "\"bytes\": %zu, \"ns\": %llu, \"bytes_per_sec\": %.6g, "
+                "\"loads\": %zu, \"iterations\": %zu, \"rate_cv\": %.6g, ",
+                res->size, res->threads, res->bytes,
+                (unsigned long long) res->ns, res->rate, res->loads,
+                res->iterations, res->rate_cv);
+        if (res->latency_ns)
+            fprintf(outf, "\"latency_ns\": %.6g, ", res->latency_ns);
+        else
+            fprintf(outf, "\"latency_ns\": null, ");
+        if (res->interval_ns)
+            fprintf(outf, "\"interval_ns\": %llu, ",
+                    (unsigned long long) res->interval_ns);
+        else
+            fprintf(outf, "\"interval_ns\": null, ");
+        if (res->cycles > 0)
+            fprintf(outf, "\"cycles\": %.0f, \"ghz\": %.4g, ",
+                    res->cycles, res->ghz);
+        else
+            fprintf(outf, "\"cycles\": null, \"ghz\": null, ");
+        fprintf(outf, "\"pages\": ");
+        print_json_value(outf, *res->pages ? res->pages : NULL, 1);
+        fprintf(outf, ", ");
+        if (res->cpu_node >= 0)
+            fprintf(outf, "\"cpu_node\": %d, ", res->cpu_node);
+        else
+            fprintf(outf, "\"cpu_node\": null, ");
+        if (res->mem_node >= 0)
+            fprintf(outf, "\"mem_node\": %d", res->mem_node);
+        else
+            fprintf(outf, "\"mem_node\": null");
+        if (r->nevents) {
+            fprintf(outf, ", \"events\": {");
+            for (int j = 0; j < r->nevents; j++) {
+                fprintf(outf, "%s", j ? ", " : "");
+                print_json_string(outf, r->events[j]);
+                if (res->events[j] >= 0)
+                    fprintf(outf, ": %.0f", res->events[j]);
+                else
+                    fprintf(outf, ": null");
+            }
+            fputc('}', outf);
+        }
+        fputc('}', outf);
+    }
+    fprintf(outf, "\n  ]\n}\n");
+}
+
+static void print_csv_string(FILE *outf, const char *s)
+{
+    if (!strpbrk(s, ",\"\n")) {
+        fprintf(outf, "%s", s);
+        return;
+    }
+
+    fputc('"', outf);
+    for (; *s; s++) {
+        if (*s == '"')
+            fputc('"', outf);
+        fputc(*s, outf);
+    }
+    fputc('"', outf);
+}
+
+/*
+ * One row per result with the configuration repeated on every row so
+ * each line stands on its own. The configuration columns are prefixed
+ * with cfg_ to keep them apart from the result columns.
+ */
+void results_print_csv(FILE *outf, const struct results *r)
+{
+    for (int i = 0; i < r->nconfig; i++)
+        fprintf(outf, "cfg_%s,", r->config[i].key);
+    fprintf(outf, "kernel,size,threads,bytes,ns,bytes_per_sec,loads,"
+            "iterations,rate_cv,latency_ns,interval_ns,cycles,ghz,pages,cpu_node,mem_node");
+    for (int i = 0; i < r->nevents; i++)
+        fprintf(outf, ",ev_%s", r->events[i]);
+    fputc('\n', outf);
+
+    for (size_t i = 0; i < r->count; i++) {
+        const struct result *res = &r->list[i];
+
+        for (int j = 0; j < r->nconfig; j++) {
+            if (r->config[j].value)
+                print_csv_string(outf, r->config[j].value);
+            fputc(',', outf);
+        }
+        print_csv_string(outf, res->kernel);
+        fprintf(outf, ",%zu,%u,%zu,%llu,%.6g,%zu,%zu,%.6g,", res->size,
+                res->threads, res->bytes, (unsigned long long) res->ns,
+                res->rate, res->loads, res->iterations, res->rate_cv);
+        if (res->latency_ns)
+            fprintf(outf, "%.6g", res->latency_ns);
+        fputc(',', outf);
+        if (res->interval_ns)
+            fprintf(outf, "%llu", (unsigned long long) res->interval_ns);
+        fputc(',', outf);
+        if (res->cycles > 0)
+            fprintf(outf, "%.0f,%.4g", res->cycles, res->ghz);
+        else
+            fputc(',', outf);
+        fputc(',', outf);
+        fprintf(outf, "%s,", res->pages);
+        if (res->cpu_node >= 0)
+            fprintf(outf, "%d", res->cpu_node);
+        fputc(',', outf);
+        if (res->mem_node >= 0)
+            fprintf(outf, "%d", res->mem_node);
+        for (int j = 0; j < r->nevents; j++) {
+            fputc(',', outf);
+            if (res->events[j] >= 0)
+                fprintf(outf, "%.0f", res->events[j]);
+        }
+        fputc('\n', outf);
+    }
+}
+
+#define CSV_MAX_LINE   8192
+#define CSV_MAX_FIELDS 64
+
+/*
+ * Split a CSV line in place, undoing the quoting print_csv_string()
+ * does. Returns the number of fields.
+ */
+static int csv_split(char *line, char **fields)
+{
+    int count = 0;
+    char *out;
+
+    line[strcspn(line, "\r\n")] = 0;
+
+    while (count < CSV_MAX_FIELDS) {
+        fields[count++] = out = line;
+        if (*line == '"') {
+            for (line++; *line; line++) {
+                if (*line == '"' && line[1] != '"')
+                    break;
+                if (*line == '"')
+                    line++;
+                *out++ = *line;
+            }
+            if (*line == '"')
+                line++;
+        } else {
+            while (*line && *line != ',')
+                *out++ = *line++;
+        }
+
+        if (*line != ',') {
+            *out = 0;
+            break;
+        }
+        line++;
+        *out = 0;
+    }
+
+    return count;
+}
+
+/*
+ * Read back a file written by results_print_csv(). Returns 0 or -1 if
+ * the file does not look like one.
+ */
+int results_load_csv(FILE *inf, struct results *r)
+{
+    char header[CSV_MAX_LINE], line[CSV_MAX_LINE];
+    char *names[CSV_MAX_FIELDS], *fields[CSV_MAX_FIELDS];
+    int nnames, nfields, kernel = -1;
+
+    results_init(r);
+    r->owns_keys = 1;
+
+    if (fgets(header, sizeof(header), inf) == NULL)
+        return -1;
+    nnames = csv_split(header, names);
+    for (int i = 0; i < nnames; i++)
+        if (!strcmp(names[i], "kernel"))
+            kernel = i;
+    if (kernel < 0)
+        return -1;
+
+    while (fgets(line, sizeof(line), inf)) {
+        struct result *res;
+
+        nfields = csv_split(line, fields);
+        if (nfields != nnames)
+            continue;
+
+        if (r->nconfig == 0) {
+            for (int i = 0; i < kernel; i++) {
+                if (strncmp(names[i], "cfg_", 4))
+                    continue;
+                results_config(r, strdup(names[i] + 4), 0,
+                               *fields[i] ? "%s" : NULL, fields[i]);
+            }
+        }
+
+        res = results_add(r, fields[kernel]);
+        for (int i = kernel + 1; i < nfields; i++) {
+            const char *f = fields[i];
+
+            if (!strcmp(names[i], "size"))
+                res->size = strtoull(f, NULL, 0);
+            else if (!strcmp(names[i], "threads"))
+                res->threads = strtoul(f, NULL, 0);
+            else if (!strcmp(names[i], "bytes"))
+                res->bytes = strtoull(f, NULL, 0);
+            else if (!strcmp(names[i], "ns"))
+                res->ns = strtoull(f, NULL, 0);
+            else if (!strcmp(names[i], "bytes_per_sec"))
+                res->rate = strtod(f, NULL);
+            else if (!strcmp(names[i], "loads"))
+                res->loads = strtoull(f, NULL, 0);
+            else if (!strcmp(names[i], "iterations"))
+                res->iterations = strtoull(f, NULL, 0);
+            else if (!strcmp(names[i], "rate_cv"))
+                res->rate_cv = strtod(f, NULL);
+            else if (!strcmp(names[i], "latency_ns"))
+                res->latency_ns = strtod(f, NULL);
+            else if (!strcmp(names[i], "interval_ns"))
+                res->interval_ns = strtoull(f, NULL, 0);
+            else if (!strcmp(names[i], "cycles"))
+                res->cycles = strtod(f, NULL);
+            else if (!strcmp(names[i], "ghz"))
+                res->ghz = strtod(f, NULL);
+            else if (!strcmp(names[i], "pages"))
+                snprintf(res->pages, sizeof(res->pages), "%s", f);
+            else if (!strcmp(names[i], "cpu_node") && *f)
+                res->cpu_node = strtol(f, NULL, 0);
+            else if (!strcmp(names[i], "mem_node") && *f)
+                res->mem_node = strtol(f, NULL, 0);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Returns NULL for keys that are missing or recorded as null.
+ */
+const char *results_get_config(const struct results *r, const char *key)
+{
+    for (int i = 0; i < r->nconfig; i++)
+        if (!strcmp(r->config[i].key, key))
+            return r->config[i].value;
+
+    return NULL;
+}
+
+/*
+ * Find the result measuring the same thing as like: the same kernel
+ * over the same size, threads, nodes and pages.
+ */
+const struct result *results_find(const struct results *r,
+                                  const struct result *like)
+{
+    for (size_t i = 0; i < r->count; i++) {
+        const struct result *res = &r->list[i];
+
+        if (!strcmp(res->kernel, like->kernel) &&
+            res->size == like->size && res->threads == like->threads &&
+            res->cpu_node == like->cpu_node &&
+            res->mem_node == like->mem_node &&
+            !strcmp(res->pages, like->pages))
+            return res;
+    }
+
+    return NULL;
+}
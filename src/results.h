@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Collecting results for machine readable output
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_RESULTS_H__
+#define __MEMBASH_RESULTS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define RESULTS_MAX_CONFIG 32
+#define RESULTS_NAME_LEN   32
+#define RESULTS_MAX_EVENTS 8
+
+/*
+ * One measurement. Fields that do not apply to a kernel are left at
+ * zero (or -1 for the nodes) and printed as null. Rows with an
+ * interval_ns are one --interval of a longer run, ending that many ns
+ * after the kernel started. cycles is summed over the threads and
+ * ghz is the effective frequency they ran at. pages is the --pages
+ * kind the buffers had, empty for the default. events holds the counts of the
+ * performance counters named in the results, negative if not counted.
+ */
+struct result {
+    char     kernel[RESULTS_NAME_LEN];
+    size_t   size;
+    unsigned threads;
+    size_t   bytes;
+    uint64_t ns;
+    double   rate;
+    size_t   loads;
+    double   latency_ns;
+    int      cpu_node;
+    int      mem_node;
+    size_t   iterations;
+    double   rate_cv;
+    uint64_t interval_ns;
+    double   cycles;
+    double   ghz;
+    char     pages[8];
+    double   events[RESULTS_MAX_EVENTS];
+};
+
+struct results {
+    struct result *list;
+    size_t count;
+    size_t alloc;
+
+    struct {
+        const char *key;
+        char *value;
+        int quoted;
+    } config[RESULTS_MAX_CONFIG];
+    int nconfig;
+    int owns_keys;
+
+    const char *events[RESULTS_MAX_EVENTS];
+    int nevents;
+};
+
+void results_init(struct results *r);
+void results_free(struct results *r);
+
+void results_config(struct results *r, const char *key, int quoted,
+                    const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+struct result *results_add(struct results *r, const char *kernel);
+
+void results_print_json(FILE *outf, const struct results *r);
+void results_print_csv(FILE *outf, const struct results *r);
+
+int results_load_csv(FILE *inf, struct results *r);
+const char *results_get_config(const struct results *r, const char *key);
+const struct result *results_find(const struct results *r,
+                                  const struct result *like);
+
+#endif
@@ -0,0 +1,473 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Explicitly vectorized memory kernels selected at run time
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#include "simd.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86
+#endif
+
+static const char *names[SIMD_COUNT] = {
+    [SIMD_SCALAR] = "scalar",
+    [SIMD_SSE2]   = "sse2",
+    [SIMD_AVX2]   = "avx2",
+    [SIMD_AVX512] = "avx512",
+};
+
+int simd_parse(const char *name)
+{
+    if (!strcmp(name, "auto"))
+        return simd_best();
+
+    for (int i = 0; i < SIMD_COUNT; i++)
+        if (!strcmp(name, names[i]))
+            return i;
+
+    return -1;
+}
+
+const char *simd_name(int isa)
+{
+    if (isa < 0 || isa >= SIMD_COUNT)
+        return "unknown";
+    return names[isa];
+}
+
+int simd_supported(int isa)
+{
+    switch (isa) {
+    case SIMD_SCALAR:
+        return 1;
+#ifdef SIMD_X86
+    case SIMD_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SIMD_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return 0;
+    }
+}
+
+int simd_best(void)
+{
+    int isa = SIMD_COUNT - 1;
+
+    while (!simd_supported(isa))
+        isa--;
+
+    return isa;
+}
+
+/*
+ * All the sum kernels add up count unsigned words modulo 2^32 so they
+ * can be checked against the zero-sum invariant of the buffer. The
+ * vector versions keep four independent accumulators so the adds
+ * never limit the rate the loads can be issued at.
+ */
+static unsigned sum_scalar(const unsigned *ptr, size_t count)
+{
+    unsigned s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i;
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        s0 += ptr[i];
+        s1 += ptr[i+1];
+        s2 += ptr[i+2];
+        s3 += ptr[i+3];
+    }
+    for (; i < count; i++)
+        s0 += ptr[i];
+
+    return s0 + s1 + s2 + s3;
+}
+
+#ifdef SIMD_X86
+
+__attribute__((target("sse2")))
+static unsigned sum_sse2(const unsigned *ptr, size_t count)
+{
+    __m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+    const size_t lanes = sizeof(__m128i) / sizeof(unsigned);
+    unsigned out[lanes];
+    size_t i;
+
+    for (i = 0; i + 4*lanes <= count; i += 4*lanes) {
+        const __m128i *v = (const __m128i *) &ptr[i];
+        s0 = _mm_add_epi32(s0, _mm_loadu_si128(v));
+        s1 = _mm_add_epi32(s1, _mm_loadu_si128(v+1));
+        s2 = _mm_add_epi32(s2, _mm_loadu_si128(v+2));
+        s3 = _mm_add_epi32(s3, _mm_loadu_si128(v+3));
+    }
+
+    s0 = _mm_add_epi32(_mm_add_epi32(s0, s1), _mm_add_epi32(s2, s3));
+    _mm_storeu_si128((__m128i *) out, s0);
+
+    return sum_scalar(out, lanes) + sum_scalar(&ptr[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static unsigned sum_avx2(const unsigned *ptr, size_t count)
+{
+    __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+    const size_t lanes = sizeof(__m256i) / sizeof(unsigned);
+    unsigned out[lanes];
+    size_t i;
+
+    for (i = 0; i + 4*lanes <= count; i += 4*lanes) {
+        const __m256i *v = (const __m256i *) &ptr[i];
+        s0 = _mm256_add_epi32(s0, _mm256_loadu_si256(v));
+        s1 = _mm256_add_epi32(s1, _mm256_loadu_si256(v+1));
+        s2 = _mm256_add_epi32(s2, _mm256_loadu_si256(v+2));
+        s3 = _mm256_add_epi32(s3, _mm256_loadu_si256(v+3));
+    }
+
+    s0 = _mm256_add_epi32(_mm256_add_epi32(s0, s1),
+                          _mm256_add_epi32(s2, s3));
+    _mm256_storeu_si256((__m256i *) out, s0);
+
+    return sum_scalar(out, lanes) + sum_scalar(&ptr[i], count - i);
+}
+
+__attribute__((target("avx512f")))
+static unsigned sum_avx512(const unsigned *ptr, size_t count)
+{
+    __m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+    const size_t lanes = sizeof(__m512i) / sizeof(unsigned);
+    size_t i;
+
+    for (i = 0; i + 4*lanes <= count; i += 4*lanes) {
+        const __m512i *v = (const __m512i *) &ptr[i];
+        s0 = _mm512_add_epi32(s0, _mm512_loadu_si512(v));
+        s1 = _mm512_add_epi32(s1, _mm512_loadu_si512(v+1));
+        s2 = _mm512_add_epi32(s2, _mm512_loadu_si512(v+2));
+        s3 = _mm512_add_epi32(s3, _mm512_loadu_si512(v+3));
+    }
+
+    s0 = _mm512_add_epi32(_mm512_add_epi32(s0, s1),
+                          _mm512_add_epi32(s2, s3));
+
+    return _mm512_reduce_add_epi32(s0) + sum_scalar(&ptr[i], count - i);
+}
+
+#endif
+
+/*
+ * The write kernels fill len bytes with SIMD_PATTERN. Regular stores
+ * pay for the read-for-ownership of every line they touch while the
+ * non-temporal ones bypass the cache and write straight to memory
+ * (or a write-combining buffer for IOMEM). Everything up to the first
+ * vector aligned address, and the tail, is written with plain 64 bit
+ * stores.
+ */
+#define SIMD_PATTERN 0x5a5a5a5a5a5a5a5aULL
+
+static void write_scalar(void *ptr, size_t len)
+{
+    volatile uint64_t *p = ptr;
+
+    for (size_t i = 0; i < len / sizeof(*p); i++)
+        p[i] = SIMD_PATTERN;
+    memset((char *) ptr + len / sizeof(*p) * sizeof(*p),
+           (uint8_t) SIMD_PATTERN, len % sizeof(*p));
+}
+
+static char *write_head(void *ptr, size_t len, size_t align)
+{
+    size_t head = -(uintptr_t) ptr & (align - 1);
+
+    if (head > len)
+        head = len;
+    write_scalar(ptr, head);
+
+    return (char *) ptr + head;
+}
+
+#ifdef SIMD_X86
+
+#define DEFINE_WRITE(name, isa, type, set1, store)                      \
+__attribute__((target(isa)))                                            \
+static void name(void *ptr, size_t len)                                 \
+{                                                                       \
+    char *end = (char *) ptr + len;                                     \
+    type *p = (type *) write_head(ptr, len, sizeof(type));              \
+    const type v = set1(SIMD_PATTERN);                                  \
+                                                                        \
+    for (; (char *) (p + 4) <= end; p += 4) {                           \
+        store(p, v);                                                    \
+        store(p+1, v);                                                  \
+        store(p+2, v);                                                  \
+        store(p+3, v);                                                  \
+    }                                                                   \
+    for (; (char *) (p + 1) <= end; p++)                                \
+        store(p, v);                                                    \
+    write_scalar(p, end - (char *) p);                                  \
+    _mm_sfence();                                                       \
+}
+
+DEFINE_WRITE(write_sse2, "sse2", __m128i, _mm_set1_epi64x,
+             _mm_store_si128)
+DEFINE_WRITE(write_nt_sse2, "sse2", __m128i, _mm_set1_epi64x,
+             _mm_stream_si128)
+DEFINE_WRITE(write_avx2, "avx2", __m256i, _mm256_set1_epi64x,
+             _mm256_store_si256)
+DEFINE_WRITE(write_nt_avx2, "avx2", __m256i, _mm256_set1_epi64x,
+             _mm256_stream_si256)
+DEFINE_WRITE(write_avx512, "avx512f", __m512i, _mm512_set1_epi64,
+             _mm512_store_si512)
+DEFINE_WRITE(write_nt_avx512, "avx512f", __m512i, _mm512_set1_epi64,
+             _mm512_stream_si512)
+
+#ifdef __x86_64__
+static void write_nt_scalar(void *ptr, size_t len)
+{
+    char *end = (char *) ptr + len;
+    long long *p = (long long *) write_head(ptr, len, sizeof(*p));
+
+    for (; (char *) (p + 1) <= end; p++)
+        _mm_stream_si64(p, SIMD_PATTERN);
+    write_scalar(p, end - (char *) p);
+    _mm_sfence();
+}
+#endif
+
+static void write_stosb(void *ptr, size_t len)
+{
+    asm volatile("rep stosb"
+                 : "+D" (ptr), "+c" (len)
+                 : "a" ((uint8_t) SIMD_PATTERN)
+                 : "memory");
+}
+
+#endif
+
+simd_sum_fn simd_get_sum(int isa)
+{
+    switch (isa) {
+#ifdef SIMD_X86
+    case SIMD_SSE2:
+        return sum_sse2;
+    case SIMD_AVX2:
+        return sum_avx2;
+    case SIMD_AVX512:
+        return sum_avx512;
+#endif
+    default:
+        return sum_scalar;
+    }
+}
+
+simd_write_fn simd_get_write(int isa)
+{
+    switch (isa) {
+#ifdef SIMD_X86
+    case SIMD_SSE2:
+        return write_sse2;
+    case SIMD_AVX2:
+        return write_avx2;
+    case SIMD_AVX512:
+        return write_avx512;
+#endif
+    default:
+        return write_scalar;
+    }
+}
+
+/*
+ * Returns NULL when the architecture has no non-temporal stores we
+ * know how to issue.
+ */
+simd_write_fn simd_get_write_nt(int isa)
+{
+    switch (isa) {
+#ifdef SIMD_X86
+    case SIMD_SSE2:
+        return write_nt_sse2;
+    case SIMD_AVX2:
+        return write_nt_avx2;
+    case SIMD_AVX512:
+        return write_nt_avx512;
+#endif
+#ifdef __x86_64__
+    case SIMD_SCALAR:
+        return write_nt_scalar;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+simd_write_fn simd_get_write_stosb(void)
+{
+#ifdef SIMD_X86
+    return write_stosb;
+#else
+    return NULL;
+#endif
+}
+
+static const char *copy_names[COPY_COUNT] = {
+    [COPY_GLIBC]  = "glibc",
+    [COPY_MOVSB]  = "movsb",
+    [COPY_LOOP64] = "loop64",
+    [COPY_AVX2]   = "avx2",
+    [COPY_AVX512] = "avx512",
+    [COPY_NT]     = "nt",
+};
+
+int simd_copy_parse(const char *name)
+{
+    for (int i = 0; i < COPY_COUNT; i++)
+        if (!strcmp(name, copy_names[i]))
+            return i;
+
+    return -1;
+}
+
+const char *simd_copy_name(int engine)
+{
+    if (engine < 0 || engine >= COPY_COUNT)
+        return "unknown";
+    return copy_names[engine];
+}
+
+/*
+ * The copy engines all copy len bytes from src to dst. glibc picks its
+ * own strategy by size and cpu (including going non-temporal above a
+ * threshold), the others each stick to one: a plain 64 bit load/store
+ * loop, rep movsb, temporal vector stores or non-temporal vector
+ * stores. The vector ones align the destination and load unaligned.
+ */
+static void copy_glibc(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+
+static void copy_loop64(void *dst, const void *src, size_t len)
+{
+    volatile uint64_t *d = dst;
+    const volatile uint64_t *s = src;
+    size_t i;
+
+    for (i = 0; i < len / sizeof(*d); i++)
+        d[i] = s[i];
+    memcpy((char *) dst + i * sizeof(*d), (const char *) src + i * sizeof(*d),
+           len % sizeof(*d));
+}
+
+#ifdef SIMD_X86
+
+static char *copy_head(void *dst, const void **src, size_t len,
+                       size_t align)
+{
+    size_t head = -(uintptr_t) dst & (align - 1);
+
+    if (head > len)
+        head = len;
+    memcpy(dst, *src, head);
+    *src = (const char *) *src + head;
+
+    return (char *) dst + head;
+}
+
+static void copy_movsb(void *dst, const void *src, size_t len)
+{
+    asm volatile("rep movsb"
+                 : "+D" (dst), "+S" (src), "+c" (len)
+                 :
+                 : "memory");
+}
+
+#define DEFINE_COPY(name, isa, type, load, store)                       \
+__attribute__((target(isa)))                                            \
+static void name(void *dst, const void *src, size_t len)                \
+{                                                                       \
+    char *end = (char *) dst + len;                                     \
+    type *d = (type *) copy_head(dst, &src, len, sizeof(type));         \
+    const type *s = src;                                                \
+                                                                        \
+    for (; (char *) (d + 4) <= end; d += 4, s += 4) {                   \
+        store(d, load(s));                                              \
+        store(d+1, load(s+1));                                          \
+        store(d+2, load(s+2));                                          \
+        store(d+3, load(s+3));                                          \
+    }                                                                   \
+    for (; (char *) (d + 1) <= end; d++, s++)                           \
+        store(d, load(s));                                              \
+    memcpy(d, s, end - (char *) d);                                     \
+    _mm_sfence();                                                       \
+}
+
+DEFINE_COPY(copy_nt_sse2, "sse2", __m128i, _mm_loadu_si128,
+            _mm_stream_si128)
+DEFINE_COPY(copy_avx2, "avx2", __m256i, _mm256_loadu_si256,
+            _mm256_store_si256)
+DEFINE_COPY(copy_nt_avx2, "avx2", __m256i, _mm256_loadu_si256,
+            _mm256_stream_si256)
+DEFINE_COPY(copy_avx512, "avx512f", __m512i, _mm512_loadu_si512,
+            _mm512_store_si512)
+DEFINE_COPY(copy_nt_avx512, "avx512f", __m512i, _mm512_loadu_si512,
+            _mm512_stream_si512)
+
+#endif
+
+/*
+ * Returns NULL for engines this machine can not run. nt uses the
+ * widest non-temporal store available.
+ */
+simd_copy_fn simd_get_copy(int engine)
+{
+    switch (engine) {
+    case COPY_GLIBC:
+        return copy_glibc;
+    case COPY_LOOP64:
+        return copy_loop64;
+#ifdef SIMD_X86
+    case COPY_MOVSB:
+        return copy_movsb;
+    case COPY_AVX2:
+        return simd_supported(SIMD_AVX2) ? copy_avx2 : NULL;
+    case COPY_AVX512:
+        return simd_supported(SIMD_AVX512) ? copy_avx512 : NULL;
+    case COPY_NT:
+        if (simd_supported(SIMD_AVX512))
+            return copy_nt_avx512;
+        if (simd_supported(SIMD_AVX2))
+            return copy_nt_avx2;
+        return simd_supported(SIMD_SSE2) ? copy_nt_sse2 : NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
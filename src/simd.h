@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Explicitly vectorized memory kernels selected at run time
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_SIMD_H__
+#define __MEMBASH_SIMD_H__
+
+#include <stddef.h>
+
+enum simd_isa {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_COUNT,
+};
+
+enum simd_copy {
+    COPY_GLIBC,
+    COPY_MOVSB,
+    COPY_LOOP64,
+    COPY_AVX2,
+    COPY_AVX512,
+    COPY_NT,
+    COPY_COUNT,
+};
+
+typedef unsigned (*simd_sum_fn)(const unsigned *ptr, size_t count);
+typedef void (*simd_write_fn)(void *ptr, size_t len);
+typedef void (*simd_copy_fn)(void *dst, const void *src, size_t len);
+
+int simd_parse(const char *name);
+const char *simd_name(int isa);
+int simd_supported(int isa);
+int simd_best(void);
+
+simd_sum_fn simd_get_sum(int isa);
+simd_write_fn simd_get_write(int isa);
+simd_write_fn simd_get_write_nt(int isa);
+simd_write_fn simd_get_write_stosb(void);
+
+int simd_copy_parse(const char *name);
+const char *simd_copy_name(int engine);
+simd_copy_fn simd_get_copy(int engine);
+
+#endif
@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Constant memory streaming statistics
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#include "stats.h"
+
+#include <string.h>
+#include <math.h>
+
+void stats_init(struct stats *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->min = UINT64_MAX;
+}
+
+/*
+ * Values below STATS_SUB_COUNT get a bucket each. Above that the
+ * bucket is picked by the position of the top bit and the
+ * STATS_SUB_BITS bits below it.
+ */
+int stats_bucket(uint64_t value)
+{
+    int shift;
+
+    if (value < STATS_SUB_COUNT)
+        return value;
+
+    shift = 63 - __builtin_clzll(value) - STATS_SUB_BITS;
+    return (shift + 1) * STATS_SUB_COUNT +
+        (int) ((value >> shift) - STATS_SUB_COUNT);
+}
+
+/*
+ * The smallest value that lands in a bucket.
+ */
+uint64_t stats_bucket_value(int bucket)
+{
+    int shift = bucket / STATS_SUB_COUNT - 1;
+
+    if (shift < 0)
+        return bucket;
+
+    return (uint64_t) (STATS_SUB_COUNT + bucket % STATS_SUB_COUNT) << shift;
+}
+
+void stats_add(struct stats *s, uint64_t value)
+{
+    double delta = value - s->mean;
+
+    s->count++;
+    s->mean += delta / s->count;
+    s->m2 += delta * (value - s->mean);
+
+    if (value < s->min)
+        s->min = value;
+    if (value > s->max)
+        s->max = value;
+
+    s->buckets[stats_bucket(value)]++;
+}
+
+/*
+ * Combine the samples of src into dst, eg. to merge per thread
+ * instances once the threads are done.
+ */
+void stats_merge(struct stats *dst, const struct stats *src)
+{
+    uint64_t count = dst->count + src->count;
+    double delta = src->mean - dst->mean;
+
+    if (src->count == 0)
+        return;
+
+    dst->m2 += src->m2 + delta * delta * dst->count * src->count / count;
+    dst->mean += delta * src->count / count;
+    dst->count = count;
+
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+
+    for (int i = 0; i < STATS_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+}
+
+double stats_stddev(const struct stats *s)
+{
+    if (s->count < 2)
+        return 0;
+    return sqrt(s->m2 / (s->count - 1));
+}
+
+/*
+ * The value below which the given fraction of the samples fall, to
+ * the resolution of the buckets (and clamped to the exact min and
+ * max).
+ */
+uint64_t stats_percentile(const struct stats *s, double fraction)
+{
+    uint64_t target, seen = 0, value;
+
+    if (s->count == 0)
+        return 0;
+
+    target = ceil(fraction * s->count);
+    if (target == 0)
+        return s->min;
+
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if (seen >= target) {
+            value = stats_bucket_value(i);
+            if (value < s->min)
+                value = s->min;
+            if (value > s->max)
+                value = s->max;
+            return value;
+        }
+    }
+
+    return s->max;
+}
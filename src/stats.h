@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     Constant memory streaming statistics
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_STATS_H__
+#define __MEMBASH_STATS_H__
+
+#include <stdint.h>
+
+/*
+ * Values are bucketed HDR style: one group of 2^STATS_SUB_BITS linear
+ * buckets per power of two, so any value is known to within about
+ * 1/2^STATS_SUB_BITS no matter how large it is.
+ */
+#define STATS_SUB_BITS  5
+#define STATS_SUB_COUNT (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS   ((64 - STATS_SUB_BITS + 1) * STATS_SUB_COUNT)
+
+struct stats {
+    uint64_t count;
+    double   mean;
+    double   m2;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[STATS_BUCKETS];
+};
+
+void stats_init(struct stats *s);
+void stats_add(struct stats *s, uint64_t value);
+void stats_merge(struct stats *dst, const struct stats *src);
+
+double stats_stddev(const struct stats *s);
+uint64_t stats_percentile(const struct stats *s, double fraction);
+
+int stats_bucket(uint64_t value);
+uint64_t stats_bucket_value(int bucket);
+
+#endif
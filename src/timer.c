@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     High resolution clock sources
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#include "timer.h"
+
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TIMER_TSC
+#endif
+
+#define TIMER_CALIBRATE_NS  50000000
+#define TIMER_OVERHEAD_RUNS 1000
+
+enum {
+    TIMER_MONOTONIC,
+    TIMER_RDTSC,
+};
+
+static int source = TIMER_MONOTONIC;
+static uint64_t overhead;
+static uint64_t tsc_base;
+static double ns_per_tick;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#ifdef TIMER_TSC
+
+static int tsc_invariant(void)
+{
+    unsigned eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) ||
+        eax < 0x80000007)
+        return 0;
+
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return !!(edx & (1 << 8));
+}
+
+static inline uint64_t tsc_read(void)
+{
+    _mm_lfence();
+    return __rdtsc();
+}
+
+/*
+ * Time a busy wait of TIMER_CALIBRATE_NS against CLOCK_MONOTONIC_RAW
+ * to get the TSC period. Timestamps are then reported in ns since the
+ * calibration.
+ */
+static void tsc_calibrate(void)
+{
+    uint64_t ns0, ns1, tsc0, tsc1;
+
+    ns0 = monotonic_ns();
+    tsc0 = tsc_read();
+    do {
+        ns1 = monotonic_ns();
+    } while (ns1 - ns0 < TIMER_CALIBRATE_NS);
+    tsc1 = tsc_read();
+
+    ns_per_tick = (double) (ns1 - ns0) / (tsc1 - tsc0);
+    tsc_base = tsc1;
+}
+
+#endif
+
+static uint64_t timer_now(void)
+{
+#ifdef TIMER_TSC
+    if (source == TIMER_RDTSC)
+        return (tsc_read() - tsc_base) * ns_per_tick;
+#endif
+    return monotonic_ns();
+}
+
+/*
+ * The cost of reading the clock ends up inside every interval we
+ * time, so take the smallest back to back difference as the overhead
+ * and have timer_stop() take it back off.
+ */
+static void measure_overhead(void)
+{
+    uint64_t t0, t1;
+
+    overhead = UINT64_MAX;
+    for (int i = 0; i < TIMER_OVERHEAD_RUNS; i++) {
+        t0 = timer_now();
+        t1 = timer_now();
+        if (t1 - t0 < overhead)
+            overhead = t1 - t0;
+    }
+}
+
+/*
+ * Pick the clock: "monotonic" for clock_gettime(CLOCK_MONOTONIC_RAW),
+ * "tsc" for the time stamp counter (which must be invariant) or
+ * "auto" for the TSC when we can trust it. Returns -1 if the clock
+ * is unknown or unusable.
+ */
+int timer_init(const char *clock)
+{
+    if (!strcmp(clock, "monotonic")) {
+        source = TIMER_MONOTONIC;
+#ifdef TIMER_TSC
+    } else if (!strcmp(clock, "tsc") || !strcmp(clock, "auto")) {
+        if (tsc_invariant()) {
+            source = TIMER_RDTSC;
+            tsc_calibrate();
+        } else if (!strcmp(clock, "tsc")) {
+            return -1;
+        } else {
+            source = TIMER_MONOTONIC;
+        }
+#else
+    } else if (!strcmp(clock, "auto")) {
+        source = TIMER_MONOTONIC;
+#endif
+    } else {
+        return -1;
+    }
+
+    measure_overhead();
+    return 0;
+}
+
+uint64_t timer_start(void)
+{
+    return timer_now();
+}
+
+uint64_t timer_stop(void)
+{
+    return timer_now() - overhead;
+}
+
+const char *timer_name(void)
+{
+    return source == TIMER_RDTSC ? "tsc" : "monotonic";
+}
+
+uint64_t timer_overhead(void)
+{
+    return overhead;
+}
+
+double timer_tsc_ghz(void)
+{
+    return source == TIMER_RDTSC ? 1 / ns_per_tick : 0;
+}
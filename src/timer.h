@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     High resolution clock sources
+//
+////////////////////////////////////////////////////////////////////////
+
+
+#ifndef __MEMBASH_TIMER_H__
+#define __MEMBASH_TIMER_H__
+
+#include <stdint.h>
+
+int timer_init(const char *clock);
+
+uint64_t timer_start(void);
+uint64_t timer_stop(void);
+
+const char *timer_name(void);
+uint64_t timer_overhead(void);
+double timer_tsc_ghz(void);
+
+#endif
@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     CPU topology discovery and thread placement
+//
+////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE
+#include "topology.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+static int read_int(const char *path, int *val)
+{
+    FILE *f = fopen(path, "r");
+    int ret;
+
+    if (f == NULL)
+        return -1;
+    ret = fscanf(f, "%d", val);
+    fclose(f);
+
+    return ret == 1 ? 0 : -1;
+}
+
+/*
+ * Parse a kernel cpulist such as "0-3,8,10-11". Returns the number of
+ * cpus found (which may be more than max_cpus) or -1 on a bad list.
+ */
+int topology_parse_cpulist(const char *list, int *cpus, int max_cpus)
+{
+    int count = 0;
+    char *end;
+
+    while (*list && *list != '\n') {
+        long lo = strtol(list, &end, 10);
+        long hi = lo;
+
+        if (end == list)
+            return -1;
+        list = end;
+        if (*list == '-') {
+            hi = strtol(++list, &end, 10);
+            if (end == list || hi < lo)
+                return -1;
+            list = end;
+        }
+
+        for (long c = lo; c <= hi; c++, count++)
+            if (count < max_cpus)
+                cpus[count] = c;
+
+        if (*list == ',')
+            list++;
+    }
+
+    return count;
+}
+
+/*
+ * Read the package and core of every online cpu we are allowed to run
+ * on. Returns the number of cpus or -1 if sysfs could not be read.
+ */
+int topology_read(struct topology_cpu **cpus)
+{
+    char path[256], line[4096];
+    struct topology_cpu *t;
+    int *online, count, n = 0;
+    cpu_set_t allowed;
+    FILE *f;
+
+    f = fopen(SYSFS_CPU "/online", "r");
+    if (f == NULL)
+        return -1;
+    if (fgets(line, sizeof(line), f) == NULL) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    count = topology_parse_cpulist(line, NULL, 0);
+    if (count <= 0)
+        return -1;
+
+    online = malloc(count * sizeof(*online));
+    t = calloc(count, sizeof(*t));
+    if (online == NULL || t == NULL) {
+        free(online);
+        free(t);
+        return -1;
+    }
+    topology_parse_cpulist(line, online, count);
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed))
+        CPU_ZERO(&allowed);
+
+    for (int i = 0; i < count; i++) {
+        if (online[i] < CPU_SETSIZE && !CPU_ISSET(online[i], &allowed))
+            continue;
+
+        t[n].cpu = online[i];
+        snprintf(path, sizeof(path),
+                 SYSFS_CPU "/cpu%d/topology/physical_package_id", online[i]);
+        if (read_int(path, &t[n].package))
+            t[n].package = 0;
+        snprintf(path, sizeof(path),
+                 SYSFS_CPU "/cpu%d/topology/core_id", online[i]);
+        if (read_int(path, &t[n].core))
+            t[n].core = online[i];
+        n++;
+    }
+    free(online);
+
+    // SMT thread index within the core and core index within the package
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (t[j].package != t[i].package)
+                continue;
+            if (t[j].core == t[i].core && t[j].cpu < t[i].cpu)
+                t[i].thread++;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (t[j].package == t[i].package && t[j].thread == 0 &&
+                t[j].core < t[i].core)
+                t[i].core_rank++;
+        }
+    }
+
+    *cpus = t;
+    return n;
+}
+
+static int cmp_compact(const void *a, const void *b)
+{
+    const struct topology_cpu *x = a, *y = b;
+
+    if (x->thread != y->thread)
+        return x->thread - y->thread;
+    if (x->package != y->package)
+        return x->package - y->package;
+    return x->core_rank - y->core_rank;
+}
+
+static int cmp_scatter(const void *a, const void *b)
+{
+    const struct topology_cpu *x = a, *y = b;
+
+    if (x->thread != y->thread)
+        return x->thread - y->thread;
+    if (x->core_rank != y->core_rank)
+        return x->core_rank - y->core_rank;
+    return x->package - y->package;
+}
+
+static int cmp_smt(const void *a, const void *b)
+{
+    const struct topology_cpu *x = a, *y = b;
+
+    if (x->package != y->package)
+        return x->package - y->package;
+    if (x->core_rank != y->core_rank)
+        return x->core_rank - y->core_rank;
+    return x->thread - y->thread;
+}
+
+/*
+ * Order the cpus for a placement policy:
+ *   compact - one thread per core, filling a package before the next
+ *   scatter - one thread per core, round robin across the packages
+ *   smt     - both SMT siblings of a core before moving to the next
+ * In compact and scatter the SMT siblings are only used once every
+ * core has a thread. Returns 0 or -1 for an unknown policy.
+ */
+int topology_place(const char *policy, struct topology_cpu *cpus,
+                   int count, int *order)
+{
+    int (*cmp)(const void *, const void *);
+
+    if (!strcmp(policy, "compact"))
+        cmp = cmp_compact;
+    else if (!strcmp(policy, "scatter"))
+        cmp = cmp_scatter;
+    else if (!strcmp(policy, "smt"))
+        cmp = cmp_smt;
+    else
+        return -1;
+
+    qsort(cpus, count, sizeof(*cpus), cmp);
+    for (int i = 0; i < count; i++)
+        order[i] = cpus[i].cpu;
+
+    return 0;
+}
+
+void topology_print_cpus(FILE *outf, const int *cpus, int count)
+{
+    for (int i = 0; i < count; i++)
+        fprintf(outf, "%s%d", i ? "," : "", cpus[i]);
+}
@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2015 PMC-Sierra, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+//
+//   Description:
+//     CPU topology discovery and thread placement
+//
+////////////////////////////////////////////////////////////////////////
+
+#ifndef __MEMBASH_TOPOLOGY_H__
+#define __MEMBASH_TOPOLOGY_H__
+
+#include <stdio.h>
+
+struct topology_cpu {
+    int cpu;
+    int package;
+    int core;
+    int core_rank;
+    int thread;
+};
+
+int topology_parse_cpulist(const char *list, int *cpus, int max_cpus);
+
+int topology_read(struct topology_cpu **cpus);
+
+int topology_place(const char *policy, struct topology_cpu *cpus,
+                   int count, int *order);
+
+void topology_print_cpus(FILE *outf, const int *cpus, int count);
+
+#endif